@@ -0,0 +1,72 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "AllocationCounter.h"
+
+static std::atomic<size_t> s_uiAllocations(0);
+
+size_t AllocationCounter::uiGetCount()
+{
+	return s_uiAllocations.load(std::memory_order_relaxed);
+}
+
+static void* pCountedAllocate(size_t uiBytes)
+{
+	s_uiAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc((uiBytes > 0) ? uiBytes : 1);
+}
+
+void* operator new(size_t uiBytes)
+{
+	void* pMemory = pCountedAllocate(uiBytes);
+	if (pMemory == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return pMemory;
+}
+
+void* operator new[](size_t uiBytes)
+{
+	return operator new(uiBytes);
+}
+
+void* operator new(size_t uiBytes, const std::nothrow_t&) noexcept
+{
+	return pCountedAllocate(uiBytes);
+}
+
+void* operator new[](size_t uiBytes, const std::nothrow_t&) noexcept
+{
+	return pCountedAllocate(uiBytes);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+
+/* Counts every allocation made through the global operator new, on any
+   thread. The operators are replaced in AllocationCounter.cpp, so the
+   counter covers the standard containers as well. Comparing the count
+   before and after a stretch of code shows whether it touched the heap */
+class AllocationCounter
+{
+public:
+	static size_t uiGetCount();
+};
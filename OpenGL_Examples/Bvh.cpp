@@ -0,0 +1,522 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include "Bvh.h"
+
+static float fSurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec3 extent = boundsMax - boundsMin;
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+static float fAxis(const glm::vec3& v, int iAxis)
+{
+	return (iAxis == 0) ? v.x : ((iAxis == 1) ? v.y : v.z);
+}
+
+/* Entry distance of the ray into the box, FLT_MAX if it misses or the box starts beyond fMaxDistance */
+static float fRayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float fMaxDistance)
+{
+	float fNear = 0.0f;
+	float fFar = fMaxDistance;
+	for (int iAxis = 0; iAxis < 3; iAxis++)
+	{
+		float fT0 = (fAxis(boundsMin, iAxis) - fAxis(origin, iAxis)) * fAxis(inverseDirection, iAxis);
+		float fT1 = (fAxis(boundsMax, iAxis) - fAxis(origin, iAxis)) * fAxis(inverseDirection, iAxis);
+		fNear = std::max(fNear, std::min(fT0, fT1));
+		fFar = std::min(fFar, std::max(fT0, fT1));
+	}
+	return (fNear <= fFar) ? fNear : FLT_MAX;
+}
+
+static float fPointBoxDistance(const glm::vec3& point, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec3 outside(std::max(std::max(boundsMin.x - point.x, 0.0f), point.x - boundsMax.x),
+		std::max(std::max(boundsMin.y - point.y, 0.0f), point.y - boundsMax.y),
+		std::max(std::max(boundsMin.z - point.z, 0.0f), point.z - boundsMax.z));
+	return std::sqrt(outside.x * outside.x + outside.y * outside.y + outside.z * outside.z);
+}
+
+Bvh::Bvh()
+{
+}
+
+void Bvh::vBuild(const BoundingSpheres& spheres)
+{
+	uint32_t uiCount = (uint32_t)spheres.uiSize();
+	m_nodes.clear();
+	m_build.resize(uiCount);
+	for (uint32_t i = 0; i < uiCount; i++)
+	{
+		m_build[i].center = glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]);
+		m_build[i].fRadius = spheres.radius[i];
+		m_build[i].uiObject = i;
+	}
+	if (uiCount > 0)
+	{
+		vBuildRange(0, uiCount, 0, m_nodes);
+	}
+	m_objects.resize(uiCount);
+	for (uint32_t i = 0; i < uiCount; i++)
+	{
+		m_objects[i] = m_build[i].uiObject;
+	}
+	m_build.clear();
+	m_build.shrink_to_fit();
+	vGather(spheres);
+}
+
+void Bvh::vComputeBounds(uint32_t uiFirst, uint32_t uiCount, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	boundsMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t i = uiFirst; i < uiFirst + uiCount; i++)
+	{
+		glm::vec3 radius(m_build[i].fRadius, m_build[i].fRadius, m_build[i].fRadius);
+		boundsMin = glm::min(boundsMin, m_build[i].center - radius);
+		boundsMax = glm::max(boundsMax, m_build[i].center + radius);
+	}
+}
+
+void Bvh::vBuildRange(uint32_t uiFirst, uint32_t uiCount, int iDepth, std::vector<Node>& nodes)
+{
+	size_t uiNode = nodes.size();
+	nodes.push_back(Node());
+	vComputeBounds(uiFirst, uiCount, nodes[uiNode].boundsMin, nodes[uiNode].boundsMax);
+
+	/* A leaf takes one or two SIMD sphere tests, splitting it further costs more box tests than it saves */
+	if (uiCount <= uiMaxLeafSize)
+	{
+		nodes[uiNode].uiRightOrFirst = uiFirst;
+		nodes[uiNode].uiCount = uiCount;
+		return;
+	}
+
+	/* Bin the centroids along every axis and take the cheapest split plane */
+	glm::vec3 centroidMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	glm::vec3 centroidMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t i = uiFirst; i < uiFirst + uiCount; i++)
+	{
+		centroidMin = glm::min(centroidMin, m_build[i].center);
+		centroidMax = glm::max(centroidMax, m_build[i].center);
+	}
+
+	int iBestAxis = -1;
+	int iBestBin = 0;
+	float fBestCost = FLT_MAX;
+	for (int iAxis = 0; iAxis < 3 && iDepth < iMaxSahDepth; iAxis++)
+	{
+		float fMin = fAxis(centroidMin, iAxis);
+		float fExtent = fAxis(centroidMax, iAxis) - fMin;
+		if (fExtent <= 0.0f)
+		{
+			continue;
+		}
+		float fBinScale = iBinCount / fExtent;
+		uint32_t auiBinCount[iBinCount] = {};
+		glm::vec3 aBinMin[iBinCount];
+		glm::vec3 aBinMax[iBinCount];
+		for (int b = 0; b < iBinCount; b++)
+		{
+			aBinMin[b] = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+			aBinMax[b] = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		}
+		for (uint32_t i = uiFirst; i < uiFirst + uiCount; i++)
+		{
+			const BuildObject& object = m_build[i];
+			int b = std::min(iBinCount - 1, (int)((fAxis(object.center, iAxis) - fMin) * fBinScale));
+			glm::vec3 radius(object.fRadius, object.fRadius, object.fRadius);
+			auiBinCount[b]++;
+			aBinMin[b] = glm::min(aBinMin[b], object.center - radius);
+			aBinMax[b] = glm::max(aBinMax[b], object.center + radius);
+		}
+
+		/* Sweep from the right to know the cost of every right side, then from the left */
+		float afRightCost[iBinCount];
+		glm::vec3 sideMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		glm::vec3 sideMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		uint32_t uiSideCount = 0;
+		for (int b = iBinCount - 1; b > 0; b--)
+		{
+			uiSideCount += auiBinCount[b];
+			sideMin = glm::min(sideMin, aBinMin[b]);
+			sideMax = glm::max(sideMax, aBinMax[b]);
+			afRightCost[b] = (uiSideCount > 0) ? fSurfaceArea(sideMin, sideMax) * uiSideCount : 0.0f;
+		}
+		sideMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		sideMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		uiSideCount = 0;
+		for (int b = 0; b < iBinCount - 1; b++)
+		{
+			uiSideCount += auiBinCount[b];
+			sideMin = glm::min(sideMin, aBinMin[b]);
+			sideMax = glm::max(sideMax, aBinMax[b]);
+			if (uiSideCount == 0 || uiSideCount == uiCount)
+			{
+				continue;
+			}
+			float fCost = fSurfaceArea(sideMin, sideMax) * uiSideCount + afRightCost[b + 1];
+			if (fCost < fBestCost)
+			{
+				fBestCost = fCost;
+				iBestAxis = iAxis;
+				iBestBin = b + 1;
+			}
+		}
+	}
+
+	uint32_t uiLeftCount;
+	if (iBestAxis >= 0)
+	{
+		float fMin = fAxis(centroidMin, iBestAxis);
+		float fBinScale = iBinCount / (fAxis(centroidMax, iBestAxis) - fMin);
+		BuildObject* pMiddle = std::partition(m_build.data() + uiFirst, m_build.data() + uiFirst + uiCount, [&](const BuildObject& object)
+		{
+			return std::min(iBinCount - 1, (int)((fAxis(object.center, iBestAxis) - fMin) * fBinScale)) < iBestBin;
+		});
+		uiLeftCount = (uint32_t)(pMiddle - (m_build.data() + uiFirst));
+	}
+	else
+	{
+		/* No useful plane, for example all centers in one spot or the tree is too deep: split by count */
+		glm::vec3 extent = centroidMax - centroidMin;
+		int iAxis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+		uiLeftCount = uiCount / 2;
+		std::nth_element(m_build.data() + uiFirst, m_build.data() + uiFirst + uiLeftCount, m_build.data() + uiFirst + uiCount, [&](const BuildObject& a, const BuildObject& b)
+		{
+			return fAxis(a.center, iAxis) < fAxis(b.center, iAxis);
+		});
+	}
+
+	nodes[uiNode].uiCount = 0;
+	if (iDepth < iParallelDepth && uiCount >= uiParallelMin)
+	{
+		/* Both halves own disjoint ranges of m_build, the left one is built on another thread */
+		std::vector<Node> leftNodes;
+		std::vector<Node> rightNodes;
+		std::thread leftBuild(&Bvh::vBuildRange, this, uiFirst, uiLeftCount, iDepth + 1, std::ref(leftNodes));
+		vBuildRange(uiFirst + uiLeftCount, uiCount - uiLeftCount, iDepth + 1, rightNodes);
+		leftBuild.join();
+
+		/* Move the subtrees behind the node, interior nodes refer to their right child by index */
+		uint32_t uiLeftOffset = (uint32_t)nodes.size();
+		uint32_t uiRightOffset = uiLeftOffset + (uint32_t)leftNodes.size();
+		for (size_t i = 0; i < leftNodes.size(); i++)
+		{
+			if (leftNodes[i].uiCount == 0)
+			{
+				leftNodes[i].uiRightOrFirst += uiLeftOffset;
+			}
+			nodes.push_back(leftNodes[i]);
+		}
+		for (size_t i = 0; i < rightNodes.size(); i++)
+		{
+			if (rightNodes[i].uiCount == 0)
+			{
+				rightNodes[i].uiRightOrFirst += uiRightOffset;
+			}
+			nodes.push_back(rightNodes[i]);
+		}
+		nodes[uiNode].uiRightOrFirst = uiRightOffset;
+	}
+	else
+	{
+		vBuildRange(uiFirst, uiLeftCount, iDepth + 1, nodes);
+		nodes[uiNode].uiRightOrFirst = (uint32_t)nodes.size();
+		vBuildRange(uiFirst + uiLeftCount, uiCount - uiLeftCount, iDepth + 1, nodes);
+	}
+}
+
+void Bvh::vGather(const BoundingSpheres& spheres)
+{
+	size_t uiCount = m_objects.size();
+	m_spheres.x.resize(uiCount);
+	m_spheres.y.resize(uiCount);
+	m_spheres.z.resize(uiCount);
+	m_spheres.radius.resize(uiCount);
+	for (size_t i = 0; i < uiCount; i++)
+	{
+		uint32_t uiObject = m_objects[i];
+		m_spheres.x[i] = spheres.x[uiObject];
+		m_spheres.y[i] = spheres.y[uiObject];
+		m_spheres.z[i] = spheres.z[uiObject];
+		m_spheres.radius[i] = spheres.radius[uiObject];
+	}
+}
+
+void Bvh::vRefit(const BoundingSpheres& spheres)
+{
+	vGather(spheres);
+
+	/* Children always come after their parent, so walking backwards sees them first */
+	for (size_t n = m_nodes.size(); n-- > 0;)
+	{
+		Node& node = m_nodes[n];
+		if (node.uiCount > 0)
+		{
+			node.boundsMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+			node.boundsMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (uint32_t i = node.uiRightOrFirst; i < node.uiRightOrFirst + node.uiCount; i++)
+			{
+				glm::vec3 center(m_spheres.x[i], m_spheres.y[i], m_spheres.z[i]);
+				glm::vec3 radius(m_spheres.radius[i], m_spheres.radius[i], m_spheres.radius[i]);
+				node.boundsMin = glm::min(node.boundsMin, center - radius);
+				node.boundsMax = glm::max(node.boundsMax, center + radius);
+			}
+		}
+		else
+		{
+			const Node& left = m_nodes[n + 1];
+			const Node& right = m_nodes[node.uiRightOrFirst];
+			node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+			node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+		}
+	}
+}
+
+size_t Bvh::uiGetSubtrees(uint32_t* puiRoots, size_t uiMaxRoots) const
+{
+	if (m_nodes.empty() || uiMaxRoots == 0)
+	{
+		return 0;
+	}
+	/* Breadth first: replace interior nodes by their children while there is room for one more root */
+	size_t uiRoots = 0;
+	puiRoots[uiRoots++] = 0;
+	bool bSplit = true;
+	while (bSplit)
+	{
+		bSplit = false;
+		for (size_t i = 0; i < uiRoots && uiRoots < uiMaxRoots; i++)
+		{
+			const Node& node = m_nodes[puiRoots[i]];
+			if (node.uiCount == 0)
+			{
+				puiRoots[uiRoots++] = node.uiRightOrFirst;
+				puiRoots[i] = puiRoots[i] + 1;
+				bSplit = true;
+			}
+		}
+	}
+	/* Nodes are stored depth first, so in node order the subtrees are in leaf order too */
+	std::sort(puiRoots, puiRoots + uiRoots);
+	return uiRoots;
+}
+
+void Bvh::vGetObjectRange(uint32_t uiNode, uint32_t& uiFirst, uint32_t& uiCount) const
+{
+	/* Leftmost and rightmost leaf of the subtree */
+	uint32_t uiLeft = uiNode;
+	while (m_nodes[uiLeft].uiCount == 0)
+	{
+		uiLeft = uiLeft + 1;
+	}
+	uint32_t uiRight = uiNode;
+	while (m_nodes[uiRight].uiCount == 0)
+	{
+		uiRight = m_nodes[uiRight].uiRightOrFirst;
+	}
+	uiFirst = m_nodes[uiLeft].uiRightOrFirst;
+	uiCount = m_nodes[uiRight].uiRightOrFirst + m_nodes[uiRight].uiCount - uiFirst;
+}
+
+size_t Bvh::uiCullSubtree(const FrustumCuller& culler, uint32_t uiRoot, uint32_t* puiVisible) const
+{
+	if (m_nodes.empty())
+	{
+		return 0;
+	}
+	const glm::vec4* pPlanes = culler.getPlanes();
+	uint32_t auiStack[iStackSize];
+	uint32_t auiPlaneMask[iStackSize];
+	int iTop = 0;
+	size_t uiVisible = 0;
+	auiStack[0] = uiRoot;
+	auiPlaneMask[0] = 0x3F;
+	iTop = 1;
+	while (iTop > 0)
+	{
+		iTop--;
+		const Node& node = m_nodes[auiStack[iTop]];
+		uint32_t uiNode = auiStack[iTop];
+		uint32_t uiMask = auiPlaneMask[iTop];
+
+		/* Planes the box is completely inside of need no testing further down */
+		glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+		glm::vec3 extent = (node.boundsMax - node.boundsMin) * 0.5f;
+		bool bOutside = false;
+		for (int p = 0; p < 6 && !bOutside; p++)
+		{
+			if (!(uiMask & (1u << p)))
+			{
+				continue;
+			}
+			float fDistance = pPlanes[p].x * center.x + pPlanes[p].y * center.y + pPlanes[p].z * center.z + pPlanes[p].w;
+			float fRadius = std::fabs(pPlanes[p].x) * extent.x + std::fabs(pPlanes[p].y) * extent.y + std::fabs(pPlanes[p].z) * extent.z;
+			if (fDistance < -fRadius)
+			{
+				bOutside = true;
+			}
+			else if (fDistance >= fRadius)
+			{
+				uiMask &= ~(1u << p);
+			}
+		}
+		if (bOutside)
+		{
+			continue;
+		}
+
+		if (node.uiCount > 0)
+		{
+			size_t uiLeafVisible;
+			if (uiMask == 0)
+			{
+				for (uint32_t i = 0; i < node.uiCount; i++)
+				{
+					puiVisible[uiVisible + i] = node.uiRightOrFirst + i;
+				}
+				uiLeafVisible = node.uiCount;
+			}
+			else
+			{
+				uiLeafVisible = culler.uiCull(m_spheres, node.uiRightOrFirst, node.uiCount, puiVisible + uiVisible);
+			}
+
+			/* Leaf order back to the caller's indices */
+			for (size_t i = uiVisible; i < uiVisible + uiLeafVisible; i++)
+			{
+				puiVisible[i] = m_objects[puiVisible[i]];
+			}
+			uiVisible += uiLeafVisible;
+		}
+		else
+		{
+			auiStack[iTop] = node.uiRightOrFirst;
+			auiPlaneMask[iTop] = uiMask;
+			auiStack[iTop + 1] = uiNode + 1;
+			auiPlaneMask[iTop + 1] = uiMask;
+			iTop += 2;
+		}
+	}
+	return uiVisible;
+}
+
+int Bvh::iRaycast(const glm::vec3& origin, const glm::vec3& direction, float& fDistance) const
+{
+	int iHit = -1;
+	fDistance = FLT_MAX;
+	if (m_nodes.empty())
+	{
+		return iHit;
+	}
+	glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	uint32_t auiStack[iStackSize];
+	int iTop = 0;
+	auiStack[iTop++] = 0;
+	while (iTop > 0)
+	{
+		uint32_t uiNode = auiStack[--iTop];
+		const Node& node = m_nodes[uiNode];
+		if (fRayBox(origin, inverseDirection, node.boundsMin, node.boundsMax, fDistance) == FLT_MAX)
+		{
+			continue;
+		}
+		if (node.uiCount > 0)
+		{
+			for (uint32_t i = node.uiRightOrFirst; i < node.uiRightOrFirst + node.uiCount; i++)
+			{
+				glm::vec3 offset = origin - glm::vec3(m_spheres.x[i], m_spheres.y[i], m_spheres.z[i]);
+				float fB = glm::dot(offset, direction);
+				float fC = glm::dot(offset, offset) - m_spheres.radius[i] * m_spheres.radius[i];
+				float fDiscriminant = fB * fB - fC;
+				if (fDiscriminant < 0.0f)
+				{
+					continue;
+				}
+				/* The far intersection counts when the ray starts inside the sphere */
+				float fRoot = std::sqrt(fDiscriminant);
+				float fT = (-fB - fRoot >= 0.0f) ? -fB - fRoot : -fB + fRoot;
+				if (fT >= 0.0f && fT < fDistance)
+				{
+					fDistance = fT;
+					iHit = (int)m_objects[i];
+				}
+			}
+		}
+		else
+		{
+			/* Visit the nearer child first, so the far one is more likely to be skipped */
+			uint32_t uiLeft = uiNode + 1;
+			uint32_t uiRight = node.uiRightOrFirst;
+			float fLeft = fRayBox(origin, inverseDirection, m_nodes[uiLeft].boundsMin, m_nodes[uiLeft].boundsMax, fDistance);
+			float fRight = fRayBox(origin, inverseDirection, m_nodes[uiRight].boundsMin, m_nodes[uiRight].boundsMax, fDistance);
+			if (fLeft < fRight)
+			{
+				std::swap(uiLeft, uiRight);
+				std::swap(fLeft, fRight);
+			}
+			if (fLeft != FLT_MAX)
+			{
+				auiStack[iTop++] = uiLeft;
+			}
+			if (fRight != FLT_MAX)
+			{
+				auiStack[iTop++] = uiRight;
+			}
+		}
+	}
+	if (iHit < 0)
+	{
+		fDistance = 0.0f;
+	}
+	return iHit;
+}
+
+int Bvh::iNearest(const glm::vec3& point, float& fDistance) const
+{
+	int iNearest = -1;
+	fDistance = FLT_MAX;
+	if (m_nodes.empty())
+	{
+		return iNearest;
+	}
+	uint32_t auiStack[iStackSize];
+	int iTop = 0;
+	auiStack[iTop++] = 0;
+	while (iTop > 0)
+	{
+		uint32_t uiNode = auiStack[--iTop];
+		const Node& node = m_nodes[uiNode];
+		if (fPointBoxDistance(point, node.boundsMin, node.boundsMax) >= fDistance)
+		{
+			continue;
+		}
+		if (node.uiCount > 0)
+		{
+			for (uint32_t i = node.uiRightOrFirst; i < node.uiRightOrFirst + node.uiCount; i++)
+			{
+				glm::vec3 offset = point - glm::vec3(m_spheres.x[i], m_spheres.y[i], m_spheres.z[i]);
+				float fSurface = std::max(std::sqrt(glm::dot(offset, offset)) - m_spheres.radius[i], 0.0f);
+				if (fSurface < fDistance)
+				{
+					fDistance = fSurface;
+					iNearest = (int)m_objects[i];
+				}
+			}
+		}
+		else
+		{
+			uint32_t uiLeft = uiNode + 1;
+			uint32_t uiRight = node.uiRightOrFirst;
+			if (fPointBoxDistance(point, m_nodes[uiLeft].boundsMin, m_nodes[uiLeft].boundsMax) < fPointBoxDistance(point, m_nodes[uiRight].boundsMin, m_nodes[uiRight].boundsMax))
+			{
+				std::swap(uiLeft, uiRight);
+			}
+			auiStack[iTop++] = uiLeft;
+			auiStack[iTop++] = uiRight;
+		}
+	}
+	return iNearest;
+}
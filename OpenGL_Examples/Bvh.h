@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <../../glm/glm.hpp>
+#include "FrustumCuller.h"
+
+/* Bounding volume hierarchy over bounding spheres. The tree is built with
+   the binned surface area heuristic, the upper levels in parallel, and
+   stored depth first in one flat array: the left child of an interior
+   node directly follows it, so only the right child index is kept and a
+   node fits into 32 bytes. The spheres are copied in leaf order, which
+   makes every subtree a contiguous range that the SIMD frustum test of
+   FrustumCuller runs over directly. Moving objects are handled by vRefit,
+   which keeps the topology and only recomputes the bounds */
+class Bvh
+{
+public:
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		uint32_t uiRightOrFirst;
+		glm::vec3 boundsMax;
+		uint32_t uiCount;
+	};
+
+	Bvh();
+
+	void vBuild(const BoundingSpheres& spheres);
+
+	/* Same objects with new positions or radii */
+	void vRefit(const BoundingSpheres& spheres);
+
+	/* Write the indices of all objects that may be visible, in no particular order. Returns their number */
+	size_t uiCull(const FrustumCuller& culler, uint32_t* puiVisible) const { return uiCullSubtree(culler, 0, puiVisible); }
+
+	/* Roots of at most uiMaxRoots disjoint subtrees that together hold every object, for culling in parallel.
+	   They come in leaf order, so their object ranges are ascending */
+	size_t uiGetSubtrees(uint32_t* puiRoots, size_t uiMaxRoots) const;
+	/* The objects below a node are a contiguous range in leaf order, a subtree never writes more than uiCount */
+	void vGetObjectRange(uint32_t uiNode, uint32_t& uiFirst, uint32_t& uiCount) const;
+	size_t uiCullSubtree(const FrustumCuller& culler, uint32_t uiRoot, uint32_t* puiVisible) const;
+
+	/* Closest object hit by the ray, -1 if none. fDistance is measured along the normalized direction */
+	int iRaycast(const glm::vec3& origin, const glm::vec3& direction, float& fDistance) const;
+
+	/* Object whose sphere surface is closest to the point, -1 for an empty tree */
+	int iNearest(const glm::vec3& point, float& fDistance) const;
+
+	const std::vector<Node>& getNodes() const { return m_nodes; }
+
+private:
+	static const uint32_t uiMaxLeafSize = 8;
+	static const int iBinCount = 16;
+	static const int iParallelDepth = 3;
+	static const size_t uiParallelMin = 4096;
+	static const int iMaxSahDepth = 48;
+	static const int iStackSize = 128;
+
+	void vBuildRange(uint32_t uiFirst, uint32_t uiCount, int iDepth, std::vector<Node>& nodes);
+	void vComputeBounds(uint32_t uiFirst, uint32_t uiCount, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+	void vGather(const BoundingSpheres& spheres);
+
+	std::vector<Node> m_nodes;
+
+	/* Spheres in leaf order and the original index of each of them */
+	BoundingSpheres m_spheres;
+	std::vector<uint32_t> m_objects;
+
+	/* Build input, partitioned in place so every range being split is contiguous in memory */
+	struct BuildObject
+	{
+		glm::vec3 center;
+		float fRadius;
+		uint32_t uiObject;
+	};
+	std::vector<BuildObject> m_build;
+};
@@ -0,0 +1,69 @@
+#include <cmath>
+#include <../../glm/gtc/matrix_transform.hpp>
+#include "Camera.h"
+
+Camera::Camera(const glm::vec3& position, const glm::vec3& front, const glm::vec3& up, float fFovDegrees, float fNear, float fFar)
+	: m_position(position), m_front(front), m_up(up), m_fFovDegrees(fFovDegrees), m_fNear(fNear), m_fFar(fFar),
+	m_iWidth(800), m_iHeight(600), m_fAspect(800.0f / 600.0f), m_fTanHalfFov(0.0f), m_bViewDirty(true), m_bProjectionDirty(true)
+{
+}
+
+void Camera::vSetViewport(int iWidth, int iHeight)
+{
+	if (iWidth <= 0 || iHeight <= 0 || (iWidth == m_iWidth && iHeight == m_iHeight))
+	{
+		return;
+	}
+	m_iWidth = iWidth;
+	m_iHeight = iHeight;
+	m_bProjectionDirty = true;
+}
+
+void Camera::vSetFieldOfView(float fFovDegrees)
+{
+	if (fFovDegrees != m_fFovDegrees)
+	{
+		m_fFovDegrees = fFovDegrees;
+		m_bProjectionDirty = true;
+	}
+}
+
+void Camera::vSetPosition(const glm::vec3& position)
+{
+	if (position != m_position)
+	{
+		m_position = position;
+		m_bViewDirty = true;
+	}
+}
+
+void Camera::vSetFront(const glm::vec3& front)
+{
+	if (front != m_front)
+	{
+		m_front = front;
+		m_bViewDirty = true;
+	}
+}
+
+bool Camera::bUpdate()
+{
+	if (!m_bViewDirty && !m_bProjectionDirty)
+	{
+		return false;
+	}
+	if (m_bProjectionDirty)
+	{
+		m_fAspect = (float)m_iWidth / (float)m_iHeight;
+		m_fTanHalfFov = tanf(glm::radians(m_fFovDegrees) * 0.5f);
+		m_projection = glm::perspective(glm::radians(m_fFovDegrees), m_fAspect, m_fNear, m_fFar);
+	}
+	if (m_bViewDirty)
+	{
+		m_view = glm::lookAt(m_position, m_position + m_front, m_up);
+	}
+	m_viewProjection = m_projection * m_view;
+	m_bViewDirty = false;
+	m_bProjectionDirty = false;
+	return true;
+}
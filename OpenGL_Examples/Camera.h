@@ -0,0 +1,53 @@
+#pragma once
+#include <../../glm/glm.hpp>
+
+/* Camera and viewport of the window. The view, the projection and their
+   product are cached; moving the camera only invalidates the view, and the
+   projection with its trigonometry is rebuilt only when the framebuffer is
+   resized or the field of view changes. bUpdate tells whether anything was
+   rebuilt, so the per frame uniform buffer can skip rewriting the matrices */
+class Camera
+{
+public:
+	Camera(const glm::vec3& position, const glm::vec3& front, const glm::vec3& up, float fFovDegrees = 45.0f, float fNear = 0.1f, float fFar = 100.0f);
+
+	/* Size of the framebuffer in pixels, a minimized window (zero size) keeps the last projection */
+	void vSetViewport(int iWidth, int iHeight);
+	void vSetFieldOfView(float fFovDegrees);
+	void vSetPosition(const glm::vec3& position);
+	void vSetFront(const glm::vec3& front);
+
+	/* Rebuild the invalidated matrices, returns true if the view-projection changed */
+	bool bUpdate();
+
+	const glm::vec3& getPosition() const { return m_position; }
+	const glm::vec3& getFront() const { return m_front; }
+	const glm::vec3& getUp() const { return m_up; }
+	int iGetWidth() const { return m_iWidth; }
+	int iGetHeight() const { return m_iHeight; }
+	float fGetAspect() const { return m_fAspect; }
+	/* tan(fov / 2), cached with the projection for building picking rays */
+	float fGetTanHalfFov() const { return m_fTanHalfFov; }
+
+	const glm::mat4& getView() const { return m_view; }
+	const glm::mat4& getProjection() const { return m_projection; }
+	const glm::mat4& getViewProjection() const { return m_viewProjection; }
+
+private:
+	glm::vec3 m_position;
+	glm::vec3 m_front;
+	glm::vec3 m_up;
+	float m_fFovDegrees;
+	float m_fNear;
+	float m_fFar;
+	int m_iWidth;
+	int m_iHeight;
+	float m_fAspect;
+	float m_fTanHalfFov;
+
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+	glm::mat4 m_viewProjection;
+	bool m_bViewDirty;
+	bool m_bProjectionDirty;
+};
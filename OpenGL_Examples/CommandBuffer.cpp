@@ -0,0 +1,369 @@
+#include <iostream>
+#include <cstring>
+#include "CommandBuffer.h"
+
+/* Arguments of every opcode, plain data of 4 byte members so the arena stays 4 byte aligned */
+struct UseProgramArgs
+{
+	GLuint uiProgram;
+};
+
+struct BindTextureArgs
+{
+	GLint iTexture;
+	GLenum eUnit;
+};
+
+struct BindVertexArrayArgs
+{
+	GLuint uiVertexArray;
+};
+
+struct SetEnabledArgs
+{
+	GLenum eCapability;
+	GLuint uiEnabled;
+};
+
+struct PolygonModeArgs
+{
+	GLenum eMode;
+};
+
+struct ClearColorArgs
+{
+	float afColor[4];
+};
+
+struct ViewportArgs
+{
+	GLint aiRect[4];
+};
+
+struct ClearArgs
+{
+	GLbitfield uiMask;
+};
+
+struct DrawArgs
+{
+	MeshRange mesh;
+	GLuint uiInstanceCount;
+	GLuint uiBaseInstance;
+};
+
+static const size_t auiArgumentSize[CommandBuffer::OP_COUNT] = {
+	sizeof(UseProgramArgs),
+	sizeof(BindTextureArgs),
+	sizeof(BindVertexArrayArgs),
+	sizeof(SetEnabledArgs),
+	sizeof(PolygonModeArgs),
+	sizeof(ClearColorArgs),
+	sizeof(ViewportArgs),
+	sizeof(ClearArgs),
+	sizeof(DrawArgs)
+};
+
+CommandBuffer::CommandBuffer(size_t uiReserveBytes)
+	: m_uiCommands(0)
+{
+	m_arena.reserve(uiReserveBytes);
+}
+
+void CommandBuffer::vReset()
+{
+	m_arena.clear();
+	m_uiCommands = 0;
+}
+
+template <typename T>
+void CommandBuffer::vRecord(Opcode eOpcode, const T& arguments)
+{
+	Header header = { (uint16_t)eOpcode, (uint16_t)sizeof(T) };
+	size_t uiOffset = m_arena.size();
+	m_arena.resize(uiOffset + sizeof(Header) + sizeof(T));
+	memcpy(&m_arena[uiOffset], &header, sizeof(Header));
+	memcpy(&m_arena[uiOffset + sizeof(Header)], &arguments, sizeof(T));
+	m_uiCommands++;
+}
+
+void CommandBuffer::vUseProgram(GLuint uiProgram)
+{
+	UseProgramArgs arguments = { uiProgram };
+	vRecord(OP_USE_PROGRAM, arguments);
+}
+
+void CommandBuffer::vBindTexture(int iTexture, GLenum eUnit)
+{
+	BindTextureArgs arguments = { iTexture, eUnit };
+	vRecord(OP_BIND_TEXTURE, arguments);
+}
+
+void CommandBuffer::vBindVertexArray(GLuint uiVertexArray)
+{
+	BindVertexArrayArgs arguments = { uiVertexArray };
+	vRecord(OP_BIND_VERTEX_ARRAY, arguments);
+}
+
+void CommandBuffer::vSetEnabled(GLenum eCapability, bool bEnabled)
+{
+	SetEnabledArgs arguments = { eCapability, bEnabled ? 1u : 0u };
+	vRecord(OP_SET_ENABLED, arguments);
+}
+
+void CommandBuffer::vPolygonMode(GLenum eMode)
+{
+	PolygonModeArgs arguments = { eMode };
+	vRecord(OP_POLYGON_MODE, arguments);
+}
+
+void CommandBuffer::vClearColor(float fRed, float fGreen, float fBlue, float fAlpha)
+{
+	ClearColorArgs arguments = { { fRed, fGreen, fBlue, fAlpha } };
+	vRecord(OP_CLEAR_COLOR, arguments);
+}
+
+void CommandBuffer::vViewport(GLint iX, GLint iY, GLsizei iWidth, GLsizei iHeight)
+{
+	ViewportArgs arguments = { { iX, iY, iWidth, iHeight } };
+	vRecord(OP_VIEWPORT, arguments);
+}
+
+void CommandBuffer::vClear(GLbitfield uiMask)
+{
+	ClearArgs arguments = { uiMask };
+	vRecord(OP_CLEAR, arguments);
+}
+
+void CommandBuffer::vDraw(const MeshRange& mesh, GLuint uiInstanceCount, GLuint uiBaseInstance)
+{
+	DrawArgs arguments = { mesh, uiInstanceCount, uiBaseInstance };
+	vRecord(OP_DRAW, arguments);
+}
+
+const char* CommandBuffer::cGetOpcodeName(Opcode eOpcode)
+{
+	static const char* acNames[OP_COUNT] = {
+		"UseProgram",
+		"BindTexture",
+		"BindVertexArray",
+		"SetEnabled",
+		"PolygonMode",
+		"ClearColor",
+		"Viewport",
+		"Clear",
+		"Draw"
+	};
+	return (eOpcode >= 0 && eOpcode < OP_COUNT) ? acNames[eOpcode] : "Unknown";
+}
+
+bool CommandBuffer::bValidate(GLuint uiFirstInstance, GLuint uiEndInstance) const
+{
+	bool bProgram = false;
+	bool bVertexArray = false;
+	uint32_t uiCommand = 0;
+	size_t uiOffset = 0;
+	while (uiOffset < m_arena.size())
+	{
+		Header header;
+		if (uiOffset + sizeof(Header) > m_arena.size())
+		{
+			std::cout << "ERROR::COMMANDS::Truncated header at byte " << uiOffset << std::endl;
+			return false;
+		}
+		memcpy(&header, &m_arena[uiOffset], sizeof(Header));
+		const unsigned char* pucArguments = &m_arena[uiOffset + sizeof(Header)];
+		if (header.uiOpcode >= OP_COUNT || header.uiSize != auiArgumentSize[header.uiOpcode])
+		{
+			std::cout << "ERROR::COMMANDS::Command " << uiCommand << " has opcode " << header.uiOpcode << " and size " << header.uiSize << std::endl;
+			return false;
+		}
+		if (uiOffset + sizeof(Header) + header.uiSize > m_arena.size())
+		{
+			std::cout << "ERROR::COMMANDS::Command " << uiCommand << " runs past the end of the buffer" << std::endl;
+			return false;
+		}
+
+		switch (header.uiOpcode)
+		{
+		case OP_USE_PROGRAM:
+		{
+			UseProgramArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			bProgram = arguments.uiProgram != 0;
+			break;
+		}
+		case OP_BIND_VERTEX_ARRAY:
+		{
+			BindVertexArrayArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			bVertexArray = arguments.uiVertexArray != 0;
+			break;
+		}
+		case OP_DRAW:
+		{
+			DrawArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			if (!bProgram || !bVertexArray)
+			{
+				std::cout << "ERROR::COMMANDS::Draw " << uiCommand << " without a program or vertex array bound" << std::endl;
+				return false;
+			}
+			if (arguments.mesh.uiIndexCount == 0 || arguments.uiBaseInstance < uiFirstInstance
+				|| (uint64_t)arguments.uiBaseInstance + arguments.uiInstanceCount > uiEndInstance)
+			{
+				std::cout << "ERROR::COMMANDS::Draw " << uiCommand << " reads instances " << arguments.uiBaseInstance << " to "
+					<< arguments.uiBaseInstance + arguments.uiInstanceCount << " outside of " << uiFirstInstance << " to " << uiEndInstance << std::endl;
+				return false;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+		uiOffset += sizeof(Header) + header.uiSize;
+		uiCommand++;
+	}
+	if (uiCommand != m_uiCommands)
+	{
+		std::cout << "ERROR::COMMANDS::Found " << uiCommand << " commands, recorded " << m_uiCommands << std::endl;
+		return false;
+	}
+	return true;
+}
+
+CommandReplayer::CommandReplayer(GLStateCache& state, TextureManager& textureManager, IndirectDrawBuffer& indirectDraw, GLenum eIndexType)
+	: m_state(state), m_textureManager(textureManager), m_indirectDraw(indirectDraw), m_eIndexType(eIndexType), m_uiProgram(0), m_uiVertexArray(0)
+{
+	for (int i = 0; i < GLStateCache::iMaxTextureUnits; i++)
+	{
+		m_aiTexture[i] = -1;
+	}
+}
+
+void CommandReplayer::vBegin()
+{
+	m_indirectDraw.vBegin();
+	m_uiProgram = 0;
+	m_uiVertexArray = 0;
+	for (int i = 0; i < GLStateCache::iMaxTextureUnits; i++)
+	{
+		m_aiTexture[i] = -1;
+	}
+}
+
+void CommandReplayer::vFlush()
+{
+	m_indirectDraw.vSubmit(GL_TRIANGLES, m_eIndexType);
+}
+
+void CommandReplayer::vEnd()
+{
+	vFlush();
+}
+
+void CommandReplayer::vReplay(const CommandBuffer& commands)
+{
+	const std::vector<unsigned char>& arena = commands.m_arena;
+	size_t uiOffset = 0;
+	while (uiOffset < arena.size())
+	{
+		CommandBuffer::Header header;
+		memcpy(&header, &arena[uiOffset], sizeof(header));
+		const unsigned char* pucArguments = &arena[uiOffset + sizeof(header)];
+		uiOffset += sizeof(header) + header.uiSize;
+
+		switch (header.uiOpcode)
+		{
+		case CommandBuffer::OP_USE_PROGRAM:
+		{
+			UseProgramArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			if (arguments.uiProgram != m_uiProgram)
+			{
+				vFlush();
+				m_uiProgram = arguments.uiProgram;
+				m_state.vUseProgram(arguments.uiProgram);
+			}
+			break;
+		}
+		case CommandBuffer::OP_BIND_TEXTURE:
+		{
+			BindTextureArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			int iUnit = (int)(arguments.eUnit - GL_TEXTURE0);
+			if (iUnit < 0 || iUnit >= GLStateCache::iMaxTextureUnits || arguments.iTexture != m_aiTexture[iUnit])
+			{
+				vFlush();
+				if (iUnit >= 0 && iUnit < GLStateCache::iMaxTextureUnits)
+				{
+					m_aiTexture[iUnit] = arguments.iTexture;
+				}
+				m_textureManager.vBind(arguments.iTexture, arguments.eUnit, m_state);
+			}
+			break;
+		}
+		case CommandBuffer::OP_BIND_VERTEX_ARRAY:
+		{
+			BindVertexArrayArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			if (arguments.uiVertexArray != m_uiVertexArray)
+			{
+				vFlush();
+				m_uiVertexArray = arguments.uiVertexArray;
+				m_state.vBindVertexArray(arguments.uiVertexArray);
+			}
+			break;
+		}
+		case CommandBuffer::OP_SET_ENABLED:
+		{
+			SetEnabledArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			vFlush();
+			m_state.vSetEnabled(arguments.eCapability, arguments.uiEnabled != 0);
+			break;
+		}
+		case CommandBuffer::OP_POLYGON_MODE:
+		{
+			PolygonModeArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			vFlush();
+			m_state.vPolygonMode(arguments.eMode);
+			break;
+		}
+		case CommandBuffer::OP_CLEAR_COLOR:
+		{
+			ClearColorArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			m_state.vClearColor(arguments.afColor[0], arguments.afColor[1], arguments.afColor[2], arguments.afColor[3]);
+			break;
+		}
+		case CommandBuffer::OP_VIEWPORT:
+		{
+			ViewportArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			vFlush();
+			m_state.vViewport(arguments.aiRect[0], arguments.aiRect[1], arguments.aiRect[2], arguments.aiRect[3]);
+			break;
+		}
+		case CommandBuffer::OP_CLEAR:
+		{
+			ClearArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			vFlush();
+			glClear(arguments.uiMask);
+			break;
+		}
+		case CommandBuffer::OP_DRAW:
+		{
+			DrawArgs arguments;
+			memcpy(&arguments, pucArguments, sizeof(arguments));
+			m_indirectDraw.vAdd(arguments.mesh, arguments.uiInstanceCount, arguments.uiBaseInstance);
+			break;
+		}
+		default:
+			std::cout << "ERROR::COMMANDS::Unknown opcode " << header.uiOpcode << std::endl;
+			return;
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <../../glad/include/glad/glad.h>
+#include "GLState.h"
+#include "IndirectDraw.h"
+#include "TextureManager.h"
+
+/* Deferred stream of render commands. Recording makes no GL call, it only
+   appends a small header (opcode and size) and the plain arguments to one
+   linear byte arena, so any thread can fill its own buffer in parallel with
+   the others. The context thread executes the buffers in order with a
+   CommandReplayer. bValidate walks a stream on the CPU alone, for checking
+   what the recorders produce without a GL context */
+class CommandBuffer
+{
+public:
+	enum Opcode
+	{
+		OP_USE_PROGRAM,
+		OP_BIND_TEXTURE,
+		OP_BIND_VERTEX_ARRAY,
+		OP_SET_ENABLED,
+		OP_POLYGON_MODE,
+		OP_CLEAR_COLOR,
+		OP_VIEWPORT,
+		OP_CLEAR,
+		OP_DRAW,
+		OP_COUNT
+	};
+
+	explicit CommandBuffer(size_t uiReserveBytes = 4096);
+
+	/* Start recording the next frame, the arena keeps its memory */
+	void vReset();
+
+	void vUseProgram(GLuint uiProgram);
+	/* iTexture is a TextureManager handle */
+	void vBindTexture(int iTexture, GLenum eUnit);
+	void vBindVertexArray(GLuint uiVertexArray);
+	void vSetEnabled(GLenum eCapability, bool bEnabled);
+	void vPolygonMode(GLenum eMode);
+	void vClearColor(float fRed, float fGreen, float fBlue, float fAlpha);
+	void vViewport(GLint iX, GLint iY, GLsizei iWidth, GLsizei iHeight);
+	void vClear(GLbitfield uiMask);
+	void vDraw(const MeshRange& mesh, GLuint uiInstanceCount, GLuint uiBaseInstance);
+
+	size_t uiGetSize() const { return m_arena.size(); }
+	uint32_t uiGetCommandCount() const { return m_uiCommands; }
+	static const char* cGetOpcodeName(Opcode eOpcode);
+
+	/* CPU only: every command is complete and known, every draw has a program and a vertex array bound
+	   before it in this buffer and reads instances inside [uiFirstInstance, uiEndInstance). Prints what is wrong */
+	bool bValidate(GLuint uiFirstInstance, GLuint uiEndInstance) const;
+
+private:
+	friend class CommandReplayer;
+	/* Corrupts recorded streams to check that bValidate rejects them */
+	friend class SelfTest;
+
+	struct Header
+	{
+		uint16_t uiOpcode;
+		uint16_t uiSize;
+	};
+
+	template <typename T>
+	void vRecord(Opcode eOpcode, const T& arguments);
+
+	std::vector<unsigned char> m_arena;
+	uint32_t m_uiCommands;
+};
+
+/* Executes command buffers on the context thread through the state cache.
+   Draws go into the indirect buffer and are issued as one multi-draw batch
+   until a command changes the state they were recorded against; a bind of
+   what is bound already does not end the batch, so the draws of buffers
+   recorded with the same state by different threads still merge */
+class CommandReplayer
+{
+public:
+	CommandReplayer(GLStateCache& state, TextureManager& textureManager, IndirectDrawBuffer& indirectDraw, GLenum eIndexType);
+
+	/* Start a frame: the next indirect region, nothing known to be bound */
+	void vBegin();
+	void vReplay(const CommandBuffer& commands);
+	/* Issue the last batch */
+	void vEnd();
+
+private:
+	void vFlush();
+
+	GLStateCache& m_state;
+	TextureManager& m_textureManager;
+	IndirectDrawBuffer& m_indirectDraw;
+	GLenum m_eIndexType;
+	GLuint m_uiProgram;
+	GLuint m_uiVertexArray;
+	int m_aiTexture[GLStateCache::iMaxTextureUnits];
+};
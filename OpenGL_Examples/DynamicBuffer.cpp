@@ -0,0 +1,86 @@
+#include <iostream>
+#include "DynamicBuffer.h"
+
+DynamicBuffer::DynamicBuffer(GLenum eTarget, size_t uiRegionBytes, int iFrameCount)
+	: m_eTarget(eTarget), m_uiBuffer(0), m_pucMapped(NULL), m_uiRegionBytes(uiRegionBytes), m_fences(iFrameCount, (GLsync)0), m_uiRegion(0)
+{
+}
+
+bool DynamicBuffer::bInit()
+{
+	/* Every region has to start where the target can bind a range */
+	GLint iAlignment = 1;
+	if (m_eTarget == GL_UNIFORM_BUFFER)
+	{
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &iAlignment);
+	}
+	else if (m_eTarget == GL_SHADER_STORAGE_BUFFER)
+	{
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &iAlignment);
+	}
+	m_uiRegionBytes = (m_uiRegionBytes + iAlignment - 1) / iAlignment * iAlignment;
+
+	GLsizeiptr iSize = (GLsizeiptr)(m_uiRegionBytes * m_fences.size());
+	GLbitfield uiFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &m_uiBuffer);
+	glBindBuffer(m_eTarget, m_uiBuffer);
+	glBufferStorage(m_eTarget, iSize, NULL, uiFlags);
+	m_pucMapped = (unsigned char*)glMapBufferRange(m_eTarget, 0, iSize, uiFlags);
+	glBindBuffer(m_eTarget, 0);
+	if (m_pucMapped == NULL)
+	{
+		std::cout << "ERROR::DYNAMIC_BUFFER::The buffer can not be mapped" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void DynamicBuffer::vRelease()
+{
+	for (size_t i = 0; i < m_fences.size(); i++)
+	{
+		if (m_fences[i])
+		{
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = 0;
+		}
+	}
+	if (m_uiBuffer)
+	{
+		glBindBuffer(m_eTarget, m_uiBuffer);
+		glUnmapBuffer(m_eTarget);
+		glBindBuffer(m_eTarget, 0);
+		glDeleteBuffers(1, &m_uiBuffer);
+		m_uiBuffer = 0;
+	}
+	m_pucMapped = NULL;
+}
+
+void* DynamicBuffer::pBegin()
+{
+	m_uiRegion = (m_uiRegion + 1) % m_fences.size();
+
+	GLsync& fence = m_fences[m_uiRegion];
+	if (fence)
+	{
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+		{
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+	return (m_pucMapped != NULL) ? m_pucMapped + m_uiRegion * m_uiRegionBytes : NULL;
+}
+
+void DynamicBuffer::vFence()
+{
+	if (m_pucMapped == NULL)
+	{
+		return;
+	}
+	if (m_fences[m_uiRegion])
+	{
+		glDeleteSync(m_fences[m_uiRegion]);
+	}
+	m_fences[m_uiRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <../../glad/include/glad/glad.h>
+
+/* Buffer for data the CPU rewrites every frame. The storage is immutable
+   and mapped once for the whole run (persistent and coherent), split into
+   one region per frame in flight. A region is fenced once the GPU work
+   reading it has been issued, and pBegin only waits on that fence when it
+   comes round to the region again, so the buffer is never re-specified or
+   orphaned and the CPU waits only if the GPU is that many frames behind */
+class DynamicBuffer
+{
+public:
+	DynamicBuffer(GLenum eTarget, size_t uiRegionBytes, int iFrameCount = 3);
+
+	/* Regions of uniform and storage buffers are rounded up to the offset alignment of their target */
+	bool bInit();
+	void vRelease();
+
+	/* Move to the next region and return it for writing, NULL if the buffer is not mapped */
+	void* pBegin();
+
+	/* The GPU work reading the current region has been issued. Fencing again replaces the older fence */
+	void vFence();
+
+	GLuint uiGetName() const { return m_uiBuffer; }
+	GLenum eGetTarget() const { return m_eTarget; }
+	bool bIsMapped() const { return m_pucMapped != NULL; }
+	int iGetFrameCount() const { return (int)m_fences.size(); }
+	size_t uiGetRegionBytes() const { return m_uiRegionBytes; }
+	/* Byte offset of the current region inside the buffer */
+	size_t uiGetRegionOffset() const { return m_uiRegion * m_uiRegionBytes; }
+
+private:
+	GLenum m_eTarget;
+	GLuint m_uiBuffer;
+	unsigned char* m_pucMapped;
+	size_t m_uiRegionBytes;
+	std::vector<GLsync> m_fences;
+	size_t m_uiRegion;
+};
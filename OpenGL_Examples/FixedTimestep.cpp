@@ -0,0 +1,28 @@
+#include "FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(double dStepSeconds, double dMaxFrameSeconds)
+	: m_dStep(dStepSeconds), m_dMaxFrame(dMaxFrameSeconds), m_dAccumulator(0.0), m_uiSteps(0)
+{
+}
+
+int FixedTimestep::iAdvance(double dFrameSeconds)
+{
+	if (dFrameSeconds > m_dMaxFrame)
+	{
+		dFrameSeconds = m_dMaxFrame;
+	}
+	else if (dFrameSeconds < 0.0)
+	{
+		dFrameSeconds = 0.0;
+	}
+	m_dAccumulator += dFrameSeconds;
+
+	int iSteps = 0;
+	while (m_dAccumulator >= m_dStep)
+	{
+		m_dAccumulator -= m_dStep;
+		iSteps++;
+	}
+	m_uiSteps += iSteps;
+	return iSteps;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+/* Accumulator for a simulation that advances in fixed steps, whatever the
+   frame rate. Every frame adds its real duration, the simulation then runs
+   as many whole steps as fit, and the remainder gives the blend factor
+   between the last two simulated states for rendering. Frames longer than
+   the clamp (a breakpoint, a dragged window) are cut short, so the
+   simulation falls behind instead of trying to catch up forever */
+class FixedTimestep
+{
+public:
+	explicit FixedTimestep(double dStepSeconds = 1.0 / 60.0, double dMaxFrameSeconds = 0.25);
+
+	/* Add the duration of the last frame, returns the number of steps to simulate now */
+	int iAdvance(double dFrameSeconds);
+
+	/* How far rendering is between the previous and the current step, from 0 to 1 */
+	float fGetAlpha() const { return (float)(m_dAccumulator / m_dStep); }
+
+	float fGetStep() const { return (float)m_dStep; }
+	/* Steps simulated since the start, the same input gives the same state at the same step */
+	uint64_t uiGetStepCount() const { return m_uiSteps; }
+
+private:
+	double m_dStep;
+	double m_dMaxFrame;
+	double m_dAccumulator;
+	uint64_t m_uiSteps;
+};
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include "FrameArena.h"
+
+FrameArena::FrameArena(size_t uiRegionBytes, int iFrameCount)
+	: m_uiRegionBytes(uiRegionBytes), m_memory(uiRegionBytes * iFrameCount), m_fences(iFrameCount, (GLsync)0), m_uiRegion(0), m_uiOffset(0), m_uiPeak(0)
+{
+}
+
+void FrameArena::vRelease()
+{
+	for (size_t i = 0; i < m_fences.size(); i++)
+	{
+		if (m_fences[i])
+		{
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = 0;
+		}
+	}
+}
+
+void FrameArena::vBeginFrame()
+{
+	m_uiPeak = std::max(m_uiPeak, m_uiOffset.load(std::memory_order_relaxed));
+	m_uiRegion = (m_uiRegion + 1) % m_fences.size();
+
+	GLsync& fence = m_fences[m_uiRegion];
+	if (fence)
+	{
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+		{
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+	m_uiOffset.store(0, std::memory_order_relaxed);
+}
+
+void FrameArena::vEndFrame()
+{
+	if (m_fences[m_uiRegion] == 0)
+	{
+		m_fences[m_uiRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+void* FrameArena::pAllocate(size_t uiBytes, size_t uiAlignment)
+{
+	unsigned char* pucRegion = m_memory.data() + m_uiRegion * m_uiRegionBytes;
+	size_t uiOffset = m_uiOffset.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		/* Align the address, the vector only guarantees the alignment of the largest fundamental type */
+		uintptr_t uiAddress = (uintptr_t)(pucRegion + uiOffset);
+		size_t uiStart = uiOffset + (size_t)((uiAlignment - uiAddress % uiAlignment) % uiAlignment);
+		if (uiStart + uiBytes > m_uiRegionBytes)
+		{
+			std::cout << "ERROR::FRAME_ARENA::The region of " << m_uiRegionBytes << " bytes is exhausted" << std::endl;
+			return NULL;
+		}
+		if (m_uiOffset.compare_exchange_weak(uiOffset, uiStart + uiBytes, std::memory_order_relaxed))
+		{
+			return pucRegion + uiStart;
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <../../glad/include/glad/glad.h>
+
+/* Linear allocator for data that lives for one frame: job closures, cull
+   lists, draw lists. The memory is split into one region per frame in
+   flight. vBeginFrame moves to the next region and rewinds it once the GPU
+   has signalled the fence of the frame that last used it, so nothing a
+   frame hands out is reused while that frame may still be in flight.
+   Allocating is a lock free bump and works from any thread, the heap is
+   only touched once, by the constructor */
+class FrameArena
+{
+public:
+	FrameArena(size_t uiRegionBytes, int iFrameCount = 3);
+
+	/* Delete the pending fences, while the GL context is still current */
+	void vRelease();
+
+	/* Move to the next region, waits for its fence if the GPU is that far behind */
+	void vBeginFrame();
+
+	/* Everything of the current frame has been submitted, fences its region */
+	void vEndFrame();
+
+	/* Aligned memory until the region comes round again, NULL once the region is full */
+	void* pAllocate(size_t uiBytes, size_t uiAlignment);
+	template <typename T>
+	T* pAllocateArray(size_t uiCount) { return (T*)pAllocate(sizeof(T) * uiCount, alignof(T)); }
+
+	size_t uiGetRegionBytes() const { return m_uiRegionBytes; }
+	/* Most bytes any frame has used so far, to size the regions */
+	size_t uiGetPeakBytes() const { return m_uiPeak; }
+
+private:
+	size_t m_uiRegionBytes;
+	std::vector<unsigned char> m_memory;
+	std::vector<GLsync> m_fences;
+	size_t m_uiRegion;
+	std::atomic<size_t> m_uiOffset;
+	size_t m_uiPeak;
+};
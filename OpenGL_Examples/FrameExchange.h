@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+
+/* Double buffered hand over of frame packets from one producer thread to
+   one consumer thread. The producer fills its own packet without any lock
+   and publishes it with a swap, the consumer copies the latest published
+   packet whenever it is ready for a new frame. Neither side ever waits for
+   the other beyond that copy: packets the consumer was too slow to see are
+   replaced by newer ones, and a consumer faster than the producer keeps
+   working with the last packet. Each published packet is also the starting
+   point of the next one, so the producer may update single members */
+template <typename T>
+class FrameExchange
+{
+public:
+	explicit FrameExchange(const T& initial = T())
+		: m_iWrite(0), m_bFresh(false), m_bClosed(false)
+	{
+		m_aPackets[0] = initial;
+		m_aPackets[1] = initial;
+	}
+
+	/* Producer side: the packet being filled, the consumer never touches it */
+	T& getWrite() { return m_aPackets[m_iWrite]; }
+
+	/* Producer side: make the filled packet the latest one */
+	void vPublish()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		int iPublished = m_iWrite;
+		m_iWrite ^= 1;
+		m_aPackets[m_iWrite] = m_aPackets[iPublished];
+		m_bFresh = true;
+	}
+
+	/* Consumer side: copy the latest packet if one was published since the last call */
+	bool bAcquire(T& packet)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_bFresh)
+		{
+			return false;
+		}
+		packet = m_aPackets[m_iWrite ^ 1];
+		m_bFresh = false;
+		return true;
+	}
+
+	/* Either side asks both to stop */
+	void vClose() { m_bClosed.store(true, std::memory_order_release); }
+	bool bIsClosed() const { return m_bClosed.load(std::memory_order_acquire); }
+
+private:
+	T m_aPackets[2];
+	int m_iWrite;
+	bool m_bFresh;
+	std::atomic<bool> m_bClosed;
+	std::mutex m_mutex;
+};
@@ -0,0 +1,32 @@
+#include <cstring>
+#include "FrameUniforms.h"
+
+FrameUniformBuffer::FrameUniformBuffer(int iFrameCount)
+	: m_buffer(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), iFrameCount), m_uiStaleRegions(iFrameCount)
+{
+}
+
+void FrameUniformBuffer::vUpdate(const FrameUniforms& uniforms, bool bCameraChanged)
+{
+	if (!m_buffer.bIsMapped())
+	{
+		return;
+	}
+	unsigned char* pucRegion = (unsigned char*)m_buffer.pBegin();
+
+	/* The regions are written in turn, so after a change every one of them gets the full block once */
+	if (bCameraChanged)
+	{
+		m_uiStaleRegions = m_buffer.iGetFrameCount();
+	}
+	if (m_uiStaleRegions > 0)
+	{
+		memcpy(pucRegion, &uniforms, sizeof(FrameUniforms));
+		m_uiStaleRegions--;
+	}
+	else
+	{
+		memcpy(pucRegion + offsetof(FrameUniforms, fTime), &uniforms.fTime, sizeof(float));
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, uiFrameUniformsBinding, m_buffer.uiGetName(), (GLintptr)m_buffer.uiGetRegionOffset(), sizeof(FrameUniforms));
+}
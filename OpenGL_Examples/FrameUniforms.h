@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <../../glad/include/glad/glad.h>
+#include <../../glm/glm.hpp>
+#include "DynamicBuffer.h"
+
+/* Binding point of the FrameUniforms block, every shader declares it with this binding */
+static const GLuint uiFrameUniformsBinding = 0;
+
+/* Mirror of the std140 FrameUniforms block, mat4 members are 64 bytes and
+   the trailing float is padded to a full vec4 */
+struct FrameUniforms
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	float fTime;
+	float afPadding[3];
+};
+
+/* Per frame camera data in a uniform buffer shared by all programs. It is
+   a dynamic buffer with one region per frame in flight, so writing a new
+   frame never overwrites data the GPU may still read */
+class FrameUniformBuffer
+{
+public:
+	explicit FrameUniformBuffer(int iFrameCount = 3);
+
+	bool bInit() { return m_buffer.bInit(); }
+	void vRelease() { m_buffer.vRelease(); }
+
+	/* Write the data of the new frame into the next free region and bind it to the shared binding point.
+	   Unless the camera changed, a region that already holds the current matrices only gets the new time */
+	void vUpdate(const FrameUniforms& uniforms, bool bCameraChanged);
+
+	/* All draws reading the current region have been issued */
+	void vEndFrame() { m_buffer.vFence(); }
+
+private:
+	DynamicBuffer m_buffer;
+	/* Regions still holding matrices of an older camera */
+	size_t m_uiStaleRegions;
+};
@@ -0,0 +1,135 @@
+#include <cmath>
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+#include "FrustumCuller.h"
+
+void FrustumCuller::vExtractPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	/* Gribb and Hartmann, the planes are sums and differences of the rows of the matrix */
+	glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+	planes[0] = row3 + row0;
+	planes[1] = row3 - row0;
+	planes[2] = row3 + row1;
+	planes[3] = row3 - row1;
+	planes[4] = row3 + row2;
+	planes[5] = row3 - row2;
+	for (int i = 0; i < 6; i++)
+	{
+		float fLength = std::sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+		planes[i] = planes[i] * (1.0f / fLength);
+	}
+}
+
+void FrustumCuller::vSetViewProjection(const glm::mat4& viewProjection)
+{
+	vExtractPlanes(viewProjection, m_planes);
+}
+
+bool FrustumCuller::bSphereVisible(float fX, float fY, float fZ, float fRadius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (m_planes[i].x * fX + m_planes[i].y * fY + m_planes[i].z * fZ + m_planes[i].w < -fRadius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t FrustumCuller::uiCullScalar(const BoundingSpheres& spheres, size_t uiFirst, size_t uiEnd, uint32_t* puiVisible) const
+{
+	size_t uiVisible = 0;
+	for (size_t i = uiFirst; i < uiEnd; i++)
+	{
+		if (bSphereVisible(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]))
+		{
+			puiVisible[uiVisible++] = (uint32_t)i;
+		}
+	}
+	return uiVisible;
+}
+
+size_t FrustumCuller::uiCull(const BoundingSpheres& spheres, size_t uiFirst, size_t uiCount, uint32_t* puiVisible) const
+{
+	const float* pfX = spheres.x.data();
+	const float* pfY = spheres.y.data();
+	const float* pfZ = spheres.z.data();
+	const float* pfRadius = spheres.radius.data();
+	size_t uiEnd = uiFirst + uiCount;
+	size_t uiVisible = 0;
+	size_t i = uiFirst;
+
+#if defined(__AVX__)
+	__m256 aPlaneX[6], aPlaneY[6], aPlaneZ[6], aPlaneW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		aPlaneX[p] = _mm256_set1_ps(m_planes[p].x);
+		aPlaneY[p] = _mm256_set1_ps(m_planes[p].y);
+		aPlaneZ[p] = _mm256_set1_ps(m_planes[p].z);
+		aPlaneW[p] = _mm256_set1_ps(m_planes[p].w);
+	}
+	for (; i + 8 <= uiEnd; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(pfX + i);
+		__m256 y = _mm256_loadu_ps(pfY + i);
+		__m256 z = _mm256_loadu_ps(pfZ + i);
+		__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(pfRadius + i));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(aPlaneX[p], x), _mm256_mul_ps(aPlaneY[p], y)), _mm256_add_ps(_mm256_mul_ps(aPlaneZ[p], z), aPlaneW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+		}
+		int iMask = _mm256_movemask_ps(inside);
+		while (iMask)
+		{
+			int iBit = 0;
+			while (!(iMask & (1 << iBit)))
+			{
+				iBit++;
+			}
+			puiVisible[uiVisible++] = (uint32_t)(i + iBit);
+			iMask &= iMask - 1;
+		}
+	}
+#else
+	__m128 aPlaneX[6], aPlaneY[6], aPlaneZ[6], aPlaneW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		aPlaneX[p] = _mm_set1_ps(m_planes[p].x);
+		aPlaneY[p] = _mm_set1_ps(m_planes[p].y);
+		aPlaneZ[p] = _mm_set1_ps(m_planes[p].z);
+		aPlaneW[p] = _mm_set1_ps(m_planes[p].w);
+	}
+	for (; i + 4 <= uiEnd; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(pfX + i);
+		__m128 y = _mm_loadu_ps(pfY + i);
+		__m128 z = _mm_loadu_ps(pfZ + i);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(pfRadius + i));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aPlaneX[p], x), _mm_mul_ps(aPlaneY[p], y)), _mm_add_ps(_mm_mul_ps(aPlaneZ[p], z), aPlaneW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+		int iMask = _mm_movemask_ps(inside);
+		for (int iBit = 0; iBit < 4; iBit++)
+		{
+			if (iMask & (1 << iBit))
+			{
+				puiVisible[uiVisible++] = (uint32_t)(i + iBit);
+			}
+		}
+	}
+#endif
+
+	return uiVisible + uiCullScalar(spheres, i, uiEnd, puiVisible + uiVisible);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <../../glm/glm.hpp>
+
+/* Bounding spheres as structure of arrays, so the culler loads four or eight
+   objects per instruction */
+struct BoundingSpheres
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+
+	size_t uiSize() const { return x.size(); }
+	void vPush(const glm::vec3& center, float fRadius)
+	{
+		x.push_back(center.x);
+		y.push_back(center.y);
+		z.push_back(center.z);
+		radius.push_back(fRadius);
+	}
+};
+
+/* Tests bounding spheres against the six planes of the view frustum. The
+   planes are taken from the view-projection matrix, the test runs on
+   eight spheres at a time with AVX, four with SSE, and the remainder of a
+   range one by one. A sphere is kept unless it lies completely outside of
+   one plane, so the result is conservative near the frustum corners */
+class FrustumCuller
+{
+public:
+	/* Planes as (normal, distance) with unit normals pointing inwards: left, right, bottom, top, near, far */
+	static void vExtractPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+	void vSetViewProjection(const glm::mat4& viewProjection);
+
+	bool bSphereVisible(float fX, float fY, float fZ, float fRadius) const;
+
+	const glm::vec4* getPlanes() const { return m_planes; }
+
+	/* Write the indices of the visible spheres in [uiFirst, uiFirst + uiCount) to puiVisible, in order.
+	   Returns how many were written, puiVisible needs room for uiCount */
+	size_t uiCull(const BoundingSpheres& spheres, size_t uiFirst, size_t uiCount, uint32_t* puiVisible) const;
+
+private:
+	size_t uiCullScalar(const BoundingSpheres& spheres, size_t uiFirst, size_t uiEnd, uint32_t* puiVisible) const;
+
+	glm::vec4 m_planes[6];
+};
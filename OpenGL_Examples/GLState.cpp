@@ -0,0 +1,213 @@
+#include <iostream>
+#include "GLState.h"
+
+/* Marks a binding nobody knows, it never equals a real GL name */
+static const GLuint uiUnknown = 0xFFFFFFFF;
+
+/* Capabilities with a shadow slot, in slot order */
+static const GLenum aeCapabilities[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST };
+
+GLStateCache::GLStateCache()
+	: m_uiFrame(0), m_bFrameLog(false)
+{
+	vInvalidate();
+	vResetCounters();
+}
+
+const char* GLStateCache::cGetCallName(StateCall eCall)
+{
+	static const char* acNames[CALL_COUNT] = {
+		"glUseProgram",
+		"glActiveTexture",
+		"glBindTexture",
+		"glBindVertexArray",
+		"glEnable/glDisable",
+		"glPolygonMode",
+		"glClearColor",
+		"glViewport"
+	};
+	return acNames[eCall];
+}
+
+void GLStateCache::vResetCounters()
+{
+	for (int i = 0; i < CALL_COUNT; i++)
+	{
+		m_auiIssued[i] = 0;
+		m_auiElided[i] = 0;
+		m_auiFrameIssued[i] = 0;
+		m_auiFrameElided[i] = 0;
+	}
+}
+
+void GLStateCache::vInvalidate()
+{
+	m_uiProgram = uiUnknown;
+	m_uiVertexArray = uiUnknown;
+	for (int i = 0; i < iCapabilityCount; i++)
+	{
+		m_aiEnabled[i] = -1;
+	}
+	m_ePolygonMode = 0;
+
+	/* No color channel is ever negative, so the first glClearColor goes through */
+	for (int i = 0; i < 4; i++)
+	{
+		m_afClearColor[i] = -1.0f;
+		m_aiViewport[i] = -1;
+	}
+	vInvalidateTextures();
+}
+
+void GLStateCache::vInvalidateTextures()
+{
+	m_eActiveUnit = 0;
+	for (int i = 0; i < iMaxTextureUnits; i++)
+	{
+		m_aeTextureTarget[i] = 0;
+		m_auiTexture[i] = uiUnknown;
+	}
+}
+
+bool GLStateCache::bChange(StateCall eCall, bool bSame)
+{
+	if (bSame)
+	{
+		m_auiElided[eCall]++;
+		m_auiFrameElided[eCall]++;
+		return false;
+	}
+	m_auiIssued[eCall]++;
+	m_auiFrameIssued[eCall]++;
+	return true;
+}
+
+int GLStateCache::iCapabilitySlot(GLenum eCapability) const
+{
+	for (int i = 0; i < iCapabilityCount; i++)
+	{
+		if (aeCapabilities[i] == eCapability)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+void GLStateCache::vEndFrame()
+{
+	if (m_bFrameLog)
+	{
+		std::cout << "GL state frame " << m_uiFrame << ":";
+		for (int i = 0; i < CALL_COUNT; i++)
+		{
+			if (m_auiFrameIssued[i] + m_auiFrameElided[i] > 0)
+			{
+				std::cout << " " << cGetCallName((StateCall)i) << " " << m_auiFrameIssued[i] << "/" << m_auiFrameElided[i];
+			}
+		}
+		std::cout << " (issued/elided)" << std::endl;
+	}
+	for (int i = 0; i < CALL_COUNT; i++)
+	{
+		m_auiFrameIssued[i] = 0;
+		m_auiFrameElided[i] = 0;
+	}
+	m_uiFrame++;
+}
+
+void GLStateCache::vUseProgram(GLuint uiProgram)
+{
+	if (bChange(CALL_USE_PROGRAM, m_uiProgram == uiProgram))
+	{
+		glUseProgram(uiProgram);
+		m_uiProgram = uiProgram;
+	}
+}
+
+void GLStateCache::vBindTexture(GLenum eUnit, GLenum eTarget, GLuint uiTexture)
+{
+	int iUnit = (int)(eUnit - GL_TEXTURE0);
+	if (iUnit < 0 || iUnit >= iMaxTextureUnits)
+	{
+		/* Units beyond the shadow copy are passed through */
+		glActiveTexture(eUnit);
+		glBindTexture(eTarget, uiTexture);
+		m_eActiveUnit = eUnit;
+		return;
+	}
+	if (bChange(CALL_BIND_TEXTURE, m_aeTextureTarget[iUnit] == eTarget && m_auiTexture[iUnit] == uiTexture))
+	{
+		if (bChange(CALL_ACTIVE_TEXTURE, m_eActiveUnit == eUnit))
+		{
+			glActiveTexture(eUnit);
+			m_eActiveUnit = eUnit;
+		}
+		glBindTexture(eTarget, uiTexture);
+		m_aeTextureTarget[iUnit] = eTarget;
+		m_auiTexture[iUnit] = uiTexture;
+	}
+}
+
+void GLStateCache::vBindVertexArray(GLuint uiVertexArray)
+{
+	if (bChange(CALL_BIND_VERTEX_ARRAY, m_uiVertexArray == uiVertexArray))
+	{
+		glBindVertexArray(uiVertexArray);
+		m_uiVertexArray = uiVertexArray;
+	}
+}
+
+void GLStateCache::vSetEnabled(GLenum eCapability, bool bEnabled)
+{
+	int iSlot = iCapabilitySlot(eCapability);
+	if (iSlot < 0 || bChange(CALL_ENABLE, m_aiEnabled[iSlot] == (bEnabled ? 1 : 0)))
+	{
+		if (bEnabled)
+		{
+			glEnable(eCapability);
+		}
+		else
+		{
+			glDisable(eCapability);
+		}
+		if (iSlot >= 0)
+		{
+			m_aiEnabled[iSlot] = bEnabled ? 1 : 0;
+		}
+	}
+}
+
+void GLStateCache::vPolygonMode(GLenum eMode)
+{
+	/* Core profile only knows GL_FRONT_AND_BACK, one mode covers both faces */
+	if (bChange(CALL_POLYGON_MODE, m_ePolygonMode == eMode))
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, eMode);
+		m_ePolygonMode = eMode;
+	}
+}
+
+void GLStateCache::vClearColor(float fRed, float fGreen, float fBlue, float fAlpha)
+{
+	if (bChange(CALL_CLEAR_COLOR, m_afClearColor[0] == fRed && m_afClearColor[1] == fGreen && m_afClearColor[2] == fBlue && m_afClearColor[3] == fAlpha))
+	{
+		glClearColor(fRed, fGreen, fBlue, fAlpha);
+		m_afClearColor[0] = fRed;
+		m_afClearColor[1] = fGreen;
+		m_afClearColor[2] = fBlue;
+		m_afClearColor[3] = fAlpha;
+	}
+}
+
+void GLStateCache::vViewport(GLint iX, GLint iY, GLsizei iWidth, GLsizei iHeight)
+{
+	if (bChange(CALL_VIEWPORT, m_aiViewport[0] == iX && m_aiViewport[1] == iY && m_aiViewport[2] == iWidth && m_aiViewport[3] == iHeight))
+	{
+		glViewport(iX, iY, iWidth, iHeight);
+		m_aiViewport[0] = iX;
+		m_aiViewport[1] = iY;
+		m_aiViewport[2] = iWidth;
+		m_aiViewport[3] = iHeight;
+	}
+}
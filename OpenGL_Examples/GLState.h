@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <../../glad/include/glad/glad.h>
+
+/* Shadow copy of the GL state the render loop changes: bindings, enables,
+   polygon mode, clear color and viewport. A call that would set what is
+   already set never reaches the driver, and every call is counted as
+   issued or elided, in total and for the current frame. Code that binds
+   behind the back of the cache (texture creation and uploads) has to
+   invalidate it afterwards */
+class GLStateCache
+{
+public:
+	enum StateCall
+	{
+		CALL_USE_PROGRAM,
+		CALL_ACTIVE_TEXTURE,
+		CALL_BIND_TEXTURE,
+		CALL_BIND_VERTEX_ARRAY,
+		CALL_ENABLE,
+		CALL_POLYGON_MODE,
+		CALL_CLEAR_COLOR,
+		CALL_VIEWPORT,
+		CALL_COUNT
+	};
+
+	static const int iMaxTextureUnits = 16;
+
+	GLStateCache();
+
+	void vUseProgram(GLuint uiProgram);
+	void vBindTexture(GLenum eUnit, GLenum eTarget, GLuint uiTexture);
+	void vBindVertexArray(GLuint uiVertexArray);
+
+	/* glEnable or glDisable, capabilities without a shadow slot are passed through */
+	void vSetEnabled(GLenum eCapability, bool bEnabled);
+	void vPolygonMode(GLenum eMode);
+	void vClearColor(float fRed, float fGreen, float fBlue, float fAlpha);
+	void vViewport(GLint iX, GLint iY, GLsizei iWidth, GLsizei iHeight);
+
+	/* Forget everything, the next call of each kind goes through */
+	void vInvalidate();
+	void vInvalidateTextures();
+
+	uint64_t uiGetIssued(StateCall eCall) const { return m_auiIssued[eCall]; }
+	uint64_t uiGetElided(StateCall eCall) const { return m_auiElided[eCall]; }
+	static const char* cGetCallName(StateCall eCall);
+	void vResetCounters();
+
+	/* With the frame log on, vEndFrame prints the calls of the frame that just ended */
+	void vSetFrameLog(bool bFrameLog) { m_bFrameLog = bFrameLog; }
+	void vEndFrame();
+
+private:
+	static const int iCapabilityCount = 4;
+
+	bool bChange(StateCall eCall, bool bSame);
+	int iCapabilitySlot(GLenum eCapability) const;
+
+	GLuint m_uiProgram;
+	GLenum m_eActiveUnit;
+	GLenum m_aeTextureTarget[iMaxTextureUnits];
+	GLuint m_auiTexture[iMaxTextureUnits];
+	GLuint m_uiVertexArray;
+	int m_aiEnabled[iCapabilityCount];
+	GLenum m_ePolygonMode;
+	float m_afClearColor[4];
+	GLint m_aiViewport[4];
+
+	uint64_t m_auiIssued[CALL_COUNT];
+	uint64_t m_auiElided[CALL_COUNT];
+	uint64_t m_auiFrameIssued[CALL_COUNT];
+	uint64_t m_auiFrameElided[CALL_COUNT];
+	uint64_t m_uiFrame;
+	bool m_bFrameLog;
+};
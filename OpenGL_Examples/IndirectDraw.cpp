@@ -0,0 +1,50 @@
+#include <iostream>
+#include "IndirectDraw.h"
+
+IndirectDrawBuffer::IndirectDrawBuffer(int iMaxCommands, int iFrameCount)
+	: m_iMaxCommands(iMaxCommands), m_buffer(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * iMaxCommands, iFrameCount), m_pCommands(NULL), m_uiCount(0), m_uiSubmitted(0)
+{
+}
+
+void IndirectDrawBuffer::vBegin()
+{
+	m_pCommands = (DrawElementsIndirectCommand*)m_buffer.pBegin();
+	m_uiCount = 0;
+	m_uiSubmitted = 0;
+}
+
+void IndirectDrawBuffer::vAdd(const MeshRange& mesh, GLuint uiInstanceCount, GLuint uiBaseInstance)
+{
+	if (m_pCommands == NULL || uiInstanceCount == 0)
+	{
+		return;
+	}
+	if (m_uiCount == (size_t)m_iMaxCommands)
+	{
+		std::cout << "ERROR::INDIRECT::Too many draw commands in one frame" << std::endl;
+		return;
+	}
+	DrawElementsIndirectCommand& command = m_pCommands[m_uiCount];
+	command.uiCount = mesh.uiIndexCount;
+	command.uiInstanceCount = uiInstanceCount;
+	command.uiFirstIndex = mesh.uiFirstIndex;
+	command.iBaseVertex = mesh.iBaseVertex;
+	command.uiBaseInstance = uiBaseInstance;
+	m_uiCount++;
+}
+
+void IndirectDrawBuffer::vSubmit(GLenum eMode, GLenum eIndexType)
+{
+	if (m_uiSubmitted == m_uiCount)
+	{
+		return;
+	}
+	size_t uiOffset = m_buffer.uiGetRegionOffset() + m_uiSubmitted * sizeof(DrawElementsIndirectCommand);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_buffer.uiGetName());
+	glMultiDrawElementsIndirect(eMode, eIndexType, (void*)uiOffset, (GLsizei)(m_uiCount - m_uiSubmitted), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	m_uiSubmitted = m_uiCount;
+
+	/* Only the fence behind the last batch of the frame matters */
+	m_buffer.vFence();
+}
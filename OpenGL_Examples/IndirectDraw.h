@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <../../glad/include/glad/glad.h>
+#include "DynamicBuffer.h"
+
+/* Layout of one record read by glMultiDrawElementsIndirect */
+struct DrawElementsIndirectCommand
+{
+	GLuint uiCount;
+	GLuint uiInstanceCount;
+	GLuint uiFirstIndex;
+	GLint iBaseVertex;
+	GLuint uiBaseInstance;
+};
+
+/* Where one mesh lives inside the shared vertex and index buffers */
+struct MeshRange
+{
+	GLuint uiIndexCount;
+	GLuint uiFirstIndex;
+	GLint iBaseVertex;
+};
+
+/* Builds the draw commands of a frame straight into a dynamic indirect
+   buffer and submits them with one glMultiDrawElementsIndirect. There is
+   one region per frame in flight, so writing the next frame never waits
+   for the GPU to finish the previous one. The CPU cost is one record per
+   mesh range, not per object */
+class IndirectDrawBuffer
+{
+public:
+	IndirectDrawBuffer(int iMaxCommands = 256, int iFrameCount = 3);
+
+	bool bInit() { return m_buffer.bInit(); }
+	void vRelease() { m_buffer.vRelease(); }
+
+	/* Move to the next frame region, waits only if the GPU is that many frames behind */
+	void vBegin();
+
+	/* Draw iInstanceCount instances of the mesh, reading instance data from uiBaseInstance on */
+	void vAdd(const MeshRange& mesh, GLuint uiInstanceCount, GLuint uiBaseInstance);
+
+	/* Issue the commands added since vBegin or the last vSubmit, the VAO with the shared buffers must be bound.
+	   Several submits per frame let state changes happen between batches */
+	void vSubmit(GLenum eMode, GLenum eIndexType);
+
+	size_t uiGetCommandCount() const { return m_uiCount; }
+
+private:
+	int m_iMaxCommands;
+	DynamicBuffer m_buffer;
+	DrawElementsIndirectCommand* m_pCommands;
+	size_t m_uiCount;
+	size_t m_uiSubmitted;
+};
@@ -0,0 +1,143 @@
+#include "InputSystem.h"
+
+InputSystem::InputSystem()
+	: m_uiDropped(0), m_dCursorX(0.0), m_dCursorY(0.0)
+{
+	for (int i = 0; i <= GLFW_KEY_LAST; i++)
+	{
+		m_aiKeyActions[i] = -1;
+		m_abKeyDown[i] = false;
+	}
+	for (int i = 0; i <= GLFW_MOUSE_BUTTON_LAST; i++)
+	{
+		m_aiButtonActions[i] = -1;
+		m_abButtonDown[i] = false;
+	}
+	for (int i = 0; i < iMaxActions; i++)
+	{
+		m_aiDownCount[i] = 0;
+		m_abPressed[i] = false;
+		m_adPressX[i] = 0.0;
+		m_adPressY[i] = 0.0;
+	}
+}
+
+void InputSystem::vAttach(GLFWwindow* window)
+{
+	glfwSetWindowUserPointer(window, this);
+	glfwSetKeyCallback(window, vKeyCallback);
+	glfwSetMouseButtonCallback(window, vMouseButtonCallback);
+	glfwSetCursorPosCallback(window, vCursorCallback);
+	glfwGetCursorPos(window, &m_dCursorX, &m_dCursorY);
+}
+
+void InputSystem::vBindKey(int iKey, int iAction)
+{
+	if (iKey >= 0 && iKey <= GLFW_KEY_LAST && iAction >= 0 && iAction < iMaxActions)
+	{
+		m_aiKeyActions[iKey] = iAction;
+	}
+}
+
+void InputSystem::vBindMouseButton(int iButton, int iAction)
+{
+	if (iButton >= 0 && iButton <= GLFW_MOUSE_BUTTON_LAST && iAction >= 0 && iAction < iMaxActions)
+	{
+		m_aiButtonActions[iButton] = iAction;
+	}
+}
+
+void InputSystem::vKeyCallback(GLFWwindow* window, int iKey, int, int iAction, int)
+{
+	/* Key repeats change nothing about the action state */
+	if (iAction == GLFW_REPEAT || iKey < 0 || iKey > GLFW_KEY_LAST)
+	{
+		return;
+	}
+	Event event = { EVENT_KEY, iKey, iAction, 0.0, 0.0 };
+	((InputSystem*)glfwGetWindowUserPointer(window))->vPush(event);
+}
+
+void InputSystem::vMouseButtonCallback(GLFWwindow* window, int iButton, int iAction, int)
+{
+	if (iButton < 0 || iButton > GLFW_MOUSE_BUTTON_LAST)
+	{
+		return;
+	}
+	Event event = { EVENT_MOUSE_BUTTON, iButton, iAction, 0.0, 0.0 };
+	glfwGetCursorPos(window, &event.dX, &event.dY);
+	((InputSystem*)glfwGetWindowUserPointer(window))->vPush(event);
+}
+
+void InputSystem::vCursorCallback(GLFWwindow* window, double dX, double dY)
+{
+	Event event = { EVENT_CURSOR, 0, 0, dX, dY };
+	((InputSystem*)glfwGetWindowUserPointer(window))->vPush(event);
+}
+
+void InputSystem::vPush(const Event& event)
+{
+	if (!m_events.bPush(event))
+	{
+		m_uiDropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void InputSystem::vApply(int iAction, bool bDown, double dX, double dY)
+{
+	if (iAction < 0)
+	{
+		return;
+	}
+	if (bDown)
+	{
+		m_aiDownCount[iAction]++;
+		if (!m_abPressed[iAction])
+		{
+			m_abPressed[iAction] = true;
+			m_adPressX[iAction] = dX;
+			m_adPressY[iAction] = dY;
+		}
+	}
+	else if (m_aiDownCount[iAction] > 0)
+	{
+		m_aiDownCount[iAction]--;
+	}
+}
+
+void InputSystem::vProcessEvents()
+{
+	for (int i = 0; i < iMaxActions; i++)
+	{
+		m_abPressed[i] = false;
+	}
+
+	Event event;
+	while (m_events.bPop(event))
+	{
+		bool bDown = event.iAction == GLFW_PRESS;
+		switch (event.eType)
+		{
+		case EVENT_KEY:
+			/* Only real transitions count, a key reported down twice is still released by one event */
+			if (m_abKeyDown[event.iCode] != bDown)
+			{
+				m_abKeyDown[event.iCode] = bDown;
+				/* Keys have no position of their own, the cursor events before them in the ring tell where the cursor was */
+				vApply(m_aiKeyActions[event.iCode], bDown, m_dCursorX, m_dCursorY);
+			}
+			break;
+		case EVENT_MOUSE_BUTTON:
+			if (m_abButtonDown[event.iCode] != bDown)
+			{
+				m_abButtonDown[event.iCode] = bDown;
+				vApply(m_aiButtonActions[event.iCode], bDown, event.dX, event.dY);
+			}
+			break;
+		case EVENT_CURSOR:
+			m_dCursorX = event.dX;
+			m_dCursorY = event.dY;
+			break;
+		}
+	}
+}
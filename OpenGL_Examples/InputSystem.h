@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <GLFW/glfw3.h>
+#include "SpscRing.h"
+
+/* Keyboard and mouse input delivered by GLFW callbacks instead of polling.
+   The callbacks only append events to a lock free ring, the consumer (the
+   thread running the simulation) drains it with vProcessEvents and maps
+   keys and buttons onto application defined actions. A press and release
+   between two drains still counts as a press, so short taps are not lost
+   however long a frame takes */
+class InputSystem
+{
+public:
+	/* Actions are small integers chosen by the application */
+	static const int iMaxActions = 32;
+
+	InputSystem();
+
+	/* Install the callbacks, the window user pointer is taken by the input system */
+	void vAttach(GLFWwindow* window);
+
+	void vBindKey(int iKey, int iAction);
+	void vBindMouseButton(int iButton, int iAction);
+
+	/* Consumer side: apply all queued events to the action states */
+	void vProcessEvents();
+
+	/* The action is held down after the last vProcessEvents */
+	bool bIsDown(int iAction) const { return m_aiDownCount[iAction] > 0; }
+	/* The action went down at least once during the last vProcessEvents */
+	bool bWasPressed(int iAction) const { return m_abPressed[iAction]; }
+	/* Cursor position at the first press of the action during the last vProcessEvents,
+	   not where the cursor went afterwards. Valid while bWasPressed */
+	double dGetPressX(int iAction) const { return m_adPressX[iAction]; }
+	double dGetPressY(int iAction) const { return m_adPressY[iAction]; }
+
+	double dGetCursorX() const { return m_dCursorX; }
+	double dGetCursorY() const { return m_dCursorY; }
+	/* Events dropped because the consumer fell a whole ring behind */
+	uint32_t uiGetDropped() const { return m_uiDropped.load(std::memory_order_relaxed); }
+
+private:
+	enum EventType
+	{
+		EVENT_KEY,
+		EVENT_MOUSE_BUTTON,
+		EVENT_CURSOR
+	};
+
+	/* Mouse buttons carry the cursor position at the time of the click */
+	struct Event
+	{
+		EventType eType;
+		int iCode;
+		int iAction;
+		double dX;
+		double dY;
+	};
+
+	static void vKeyCallback(GLFWwindow* window, int iKey, int iScancode, int iAction, int iMods);
+	static void vMouseButtonCallback(GLFWwindow* window, int iButton, int iAction, int iMods);
+	static void vCursorCallback(GLFWwindow* window, double dX, double dY);
+	void vPush(const Event& event);
+	void vApply(int iAction, bool bDown, double dX, double dY);
+
+	SpscRing<Event, 1024> m_events;
+	std::atomic<uint32_t> m_uiDropped;
+
+	/* Action bound to every key and mouse button, -1 if none */
+	int m_aiKeyActions[GLFW_KEY_LAST + 1];
+	int m_aiButtonActions[GLFW_MOUSE_BUTTON_LAST + 1];
+	bool m_abKeyDown[GLFW_KEY_LAST + 1];
+	bool m_abButtonDown[GLFW_MOUSE_BUTTON_LAST + 1];
+
+	/* Several keys may map to one action, it is down while any of them is */
+	int m_aiDownCount[iMaxActions];
+	bool m_abPressed[iMaxActions];
+	double m_adPressX[iMaxActions];
+	double m_adPressY[iMaxActions];
+	double m_dCursorX;
+	double m_dCursorY;
+};
@@ -0,0 +1,6 @@
+#include "InstanceBuffer.h"
+
+InstanceBuffer::InstanceBuffer(int iCapacity, int iFrameCount)
+	: m_iCapacity(iCapacity), m_buffer(GL_ARRAY_BUFFER, sizeof(glm::mat4) * iCapacity, iFrameCount)
+{
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <../../glad/include/glad/glad.h>
+#include <../../glm/glm.hpp>
+#include "DynamicBuffer.h"
+
+/* Per instance model matrices written every frame, for example only the
+   instances that survived culling, in a dynamic buffer with one region
+   per frame in flight. The vertex attributes point at the start of the
+   buffer, a draw reaches the current region by adding uiGetBaseInstance
+   to its base instance */
+class InstanceBuffer
+{
+public:
+	InstanceBuffer(int iCapacity, int iFrameCount = 3);
+
+	bool bInit() { return m_buffer.bInit(); }
+	void vRelease() { m_buffer.vRelease(); }
+
+	/* Move to the next region and return it for writing, room for iGetCapacity matrices */
+	glm::mat4* pBegin() { return (glm::mat4*)m_buffer.pBegin(); }
+
+	/* All draws reading the current region have been issued */
+	void vEndFrame() { m_buffer.vFence(); }
+
+	GLuint uiGetName() const { return m_buffer.uiGetName(); }
+	GLuint uiGetBaseInstance() const { return (GLuint)(m_buffer.uiGetRegionOffset() / sizeof(glm::mat4)); }
+	int iGetCapacity() const { return m_iCapacity; }
+
+private:
+	int m_iCapacity;
+	DynamicBuffer m_buffer;
+};
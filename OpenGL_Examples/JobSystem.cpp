@@ -0,0 +1,216 @@
+#include "JobSystem.h"
+
+/* Which system and deque the calling thread belongs to, -1 for threads outside of it */
+static thread_local const JobSystem* s_pThreadSystem = NULL;
+static thread_local int s_iThreadIndex = -1;
+
+JobSystem::Deque::Deque()
+	: m_iTop(0), m_iBottom(0)
+{
+	for (int64_t i = 0; i < iCapacity; i++)
+	{
+		m_apJobs[i].store(NULL, std::memory_order_relaxed);
+	}
+}
+
+bool JobSystem::Deque::bPush(Job* pJob)
+{
+	int64_t iBottom = m_iBottom.load(std::memory_order_relaxed);
+	int64_t iTop = m_iTop.load(std::memory_order_acquire);
+	if (iBottom - iTop >= iCapacity)
+	{
+		return false;
+	}
+	m_apJobs[iBottom & (iCapacity - 1)].store(pJob, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_iBottom.store(iBottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+Job* JobSystem::Deque::pPop()
+{
+	int64_t iBottom = m_iBottom.load(std::memory_order_relaxed) - 1;
+	m_iBottom.store(iBottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t iTop = m_iTop.load(std::memory_order_relaxed);
+	if (iTop > iBottom)
+	{
+		m_iBottom.store(iBottom + 1, std::memory_order_relaxed);
+		return NULL;
+	}
+	Job* pJob = m_apJobs[iBottom & (iCapacity - 1)].load(std::memory_order_relaxed);
+	if (iTop == iBottom)
+	{
+		/* The last job, a thief may be taking it at the same time */
+		if (!m_iTop.compare_exchange_strong(iTop, iTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			pJob = NULL;
+		}
+		m_iBottom.store(iBottom + 1, std::memory_order_relaxed);
+	}
+	return pJob;
+}
+
+Job* JobSystem::Deque::pSteal()
+{
+	int64_t iTop = m_iTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t iBottom = m_iBottom.load(std::memory_order_acquire);
+	if (iTop >= iBottom)
+	{
+		return NULL;
+	}
+	Job* pJob = m_apJobs[iTop & (iCapacity - 1)].load(std::memory_order_relaxed);
+	if (!m_iTop.compare_exchange_strong(iTop, iTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return NULL;
+	}
+	return pJob;
+}
+
+JobSystem::JobSystem(FrameArena& arena, int iWorkerThreads)
+	: m_iQueued(0), m_bStop(false), m_iSleeping(0), m_arena(arena)
+{
+	if (iWorkerThreads < 0)
+	{
+		int iCores = (int)std::thread::hardware_concurrency();
+		iWorkerThreads = (iCores > 1) ? iCores - 1 : 0;
+	}
+	for (int i = 0; i <= iWorkerThreads; i++)
+	{
+		m_deques.push_back(new Deque());
+	}
+	s_pThreadSystem = this;
+	s_iThreadIndex = 0;
+	for (int i = 1; i <= iWorkerThreads; i++)
+	{
+		m_workers.push_back(std::thread(&JobSystem::vWorker, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bStop.store(true);
+	}
+	m_wakeUp.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	for (size_t i = 0; i < m_deques.size(); i++)
+	{
+		delete m_deques[i];
+	}
+	if (s_pThreadSystem == this)
+	{
+		s_pThreadSystem = NULL;
+		s_iThreadIndex = -1;
+	}
+}
+
+int JobSystem::iCurrentThread() const
+{
+	return (s_pThreadSystem == this) ? s_iThreadIndex : -1;
+}
+
+void JobSystem::vRun(JobFunction pfnRun, void* pData, size_t uiBegin, size_t uiEnd, JobCounter& counter)
+{
+	counter.m_iCount.fetch_add(1, std::memory_order_relaxed);
+	int iThread = iCurrentThread();
+	Job* pJob = (iThread >= 0) ? m_arena.pAllocateArray<Job>(1) : NULL;
+	if (pJob == NULL)
+	{
+		/* Threads outside of the system, or no memory left, run it right away */
+		Job job = { pfnRun, pData, uiBegin, uiEnd, &counter };
+		vExecute(&job);
+		return;
+	}
+	pJob->pfnRun = pfnRun;
+	pJob->pData = pData;
+	pJob->uiBegin = uiBegin;
+	pJob->uiEnd = uiEnd;
+	pJob->pCounter = &counter;
+	if (!m_deques[iThread]->bPush(pJob))
+	{
+		vExecute(pJob);
+		return;
+	}
+	/* Sequentially consistent, the mirror image of a sleeper announcing itself and then looking at the queue */
+	m_iQueued.fetch_add(1);
+	if (m_iSleeping.load() > 0)
+	{
+		/* Taking the lock orders the wake up after a sleeper's last look at the queue */
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_wakeUp.notify_one();
+	}
+}
+
+Job* JobSystem::pFind(int iThread)
+{
+	Job* pJob = m_deques[iThread]->pPop();
+	int iCount = (int)m_deques.size();
+	for (int i = 1; pJob == NULL && i < iCount; i++)
+	{
+		pJob = m_deques[(iThread + i) % iCount]->pSteal();
+	}
+	if (pJob != NULL)
+	{
+		m_iQueued.fetch_sub(1, std::memory_order_relaxed);
+	}
+	return pJob;
+}
+
+void JobSystem::vExecute(Job* pJob)
+{
+	pJob->pfnRun(pJob->pData, pJob->uiBegin, pJob->uiEnd);
+	pJob->pCounter->m_iCount.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::vWait(JobCounter& counter)
+{
+	int iThread = iCurrentThread();
+	while (!counter.bDone())
+	{
+		Job* pJob = (iThread >= 0) ? pFind(iThread) : NULL;
+		if (pJob != NULL)
+		{
+			vExecute(pJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::vWorker(int iThread)
+{
+	s_pThreadSystem = this;
+	s_iThreadIndex = iThread;
+	int iIdle = 0;
+	while (!m_bStop.load(std::memory_order_acquire))
+	{
+		Job* pJob = pFind(iThread);
+		if (pJob != NULL)
+		{
+			vExecute(pJob);
+			iIdle = 0;
+			continue;
+		}
+		/* Spin a little for the next burst of jobs, then sleep until there is work */
+		if (++iIdle < 64)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_iSleeping.fetch_add(1);
+		m_wakeUp.wait(lock, [this]() { return m_bStop.load() || m_iQueued.load() > 0; });
+		m_iSleeping.fetch_sub(1);
+		iIdle = 0;
+	}
+}
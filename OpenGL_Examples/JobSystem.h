@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "FrameArena.h"
+
+/* Counts the unfinished jobs of a group. Jobs are added to it when they
+   are submitted and taken off when they complete, so whatever depends on
+   the group waits until it reaches zero */
+class JobCounter
+{
+public:
+	JobCounter()
+		: m_iCount(0)
+	{
+	}
+
+	bool bDone() const { return m_iCount.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	std::atomic<int> m_iCount;
+};
+
+typedef void (*JobFunction)(void* pData, size_t uiBegin, size_t uiEnd);
+
+struct Job
+{
+	JobFunction pfnRun;
+	void* pData;
+	size_t uiBegin;
+	size_t uiEnd;
+	JobCounter* pCounter;
+};
+
+/* Work stealing job scheduler. Every thread has its own deque: it pushes
+   and pops at the bottom without contention, idle threads steal from the
+   top of the others (Chase-Lev). The thread that creates the system is
+   thread 0 and submits the frame's work; instead of blocking, vWait runs
+   jobs until the counter it waits for reaches zero. Jobs and their data
+   live in the frame arena, so submitting does not touch the heap */
+class JobSystem
+{
+public:
+	/* iWorkerThreads below zero takes one worker per core besides the calling thread */
+	explicit JobSystem(FrameArena& arena, int iWorkerThreads = -1);
+	~JobSystem();
+
+	/* Frame scoped memory from any thread, no job may outlive the frame that submitted it */
+	FrameArena& getArena() { return m_arena; }
+
+	/* Submit one job, from thread 0 or from inside a job */
+	void vRun(JobFunction pfnRun, void* pData, size_t uiBegin, size_t uiEnd, JobCounter& counter);
+
+	/* Split [0, uiCount) into jobs of uiGrain items that call function(uiBegin, uiEnd).
+	   The function object is copied into the frame arena and never destroyed */
+	template <typename F>
+	void vParallelFor(size_t uiCount, size_t uiGrain, const F& function, JobCounter& counter);
+
+	/* Run jobs until the counter reaches zero */
+	void vWait(JobCounter& counter);
+
+	/* Worker threads plus thread 0 */
+	int iGetThreadCount() const { return (int)m_deques.size(); }
+
+private:
+	/* Chase-Lev deque of fixed capacity, pushes fail instead of growing */
+	class Deque
+	{
+	public:
+		static const int64_t iCapacity = 4096;
+
+		Deque();
+		bool bPush(Job* pJob);
+		Job* pPop();
+		Job* pSteal();
+
+	private:
+		/* Thieves write the top and the owner the bottom, the padding keeps them on separate cache lines */
+		std::atomic<int64_t> m_iTop;
+		char acPadding[64];
+		std::atomic<int64_t> m_iBottom;
+		std::atomic<Job*> m_apJobs[iCapacity];
+	};
+
+	template <typename F>
+	static void vInvoke(void* pData, size_t uiBegin, size_t uiEnd) { (*(F*)pData)(uiBegin, uiEnd); }
+
+	void vWorker(int iThread);
+	Job* pFind(int iThread);
+	void vExecute(Job* pJob);
+	int iCurrentThread() const;
+
+	std::vector<Deque*> m_deques;
+	std::vector<std::thread> m_workers;
+	std::atomic<int> m_iQueued;
+	std::atomic<bool> m_bStop;
+	std::atomic<int> m_iSleeping;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeUp;
+
+	FrameArena& m_arena;
+};
+
+template <typename F>
+void JobSystem::vParallelFor(size_t uiCount, size_t uiGrain, const F& function, JobCounter& counter)
+{
+	static_assert(std::is_trivially_destructible<F>::value, "Job functions are never destroyed");
+	if (uiCount == 0)
+	{
+		return;
+	}
+	void* pMemory = m_arena.pAllocate(sizeof(F), alignof(F));
+	if (pMemory == NULL)
+	{
+		function(0, uiCount);
+		return;
+	}
+	F* pFunction = new (pMemory) F(function);
+	if (uiGrain == 0)
+	{
+		uiGrain = 1;
+	}
+	for (size_t uiBegin = 0; uiBegin < uiCount; uiBegin += uiGrain)
+	{
+		size_t uiEnd = (uiCount - uiBegin > uiGrain) ? uiBegin + uiGrain : uiCount;
+		vRun(&vInvoke<F>, pFunction, uiBegin, uiEnd, counter);
+	}
+}
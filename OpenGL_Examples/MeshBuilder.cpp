@@ -0,0 +1,256 @@
+#include <iostream>
+#include <cstring>
+#include "MeshBuilder.h"
+
+MeshBuilder::MeshBuilder(int iFloatsPerVertex)
+	: m_iFloatsPerVertex(iFloatsPerVertex), m_table(64, 0)
+{
+}
+
+uint32_t MeshBuilder::uiHash(const float* pfVertex) const
+{
+	/* FNV-1a over the bits, welding only merges exact copies */
+	uint32_t uiHash = 2166136261u;
+	const unsigned char* pucBytes = (const unsigned char*)pfVertex;
+	for (size_t i = 0; i < m_iFloatsPerVertex * sizeof(float); i++)
+	{
+		uiHash = (uiHash ^ pucBytes[i]) * 16777619u;
+	}
+	return uiHash;
+}
+
+int MeshBuilder::iFind(const float* pfVertex, uint32_t uiHash) const
+{
+	size_t uiMask = m_table.size() - 1;
+	for (size_t uiBucket = uiHash & uiMask; m_table[uiBucket] != 0; uiBucket = (uiBucket + 1) & uiMask)
+	{
+		int iVertex = (int)m_table[uiBucket] - 1;
+		if (memcmp(&m_vertices[(size_t)iVertex * m_iFloatsPerVertex], pfVertex, m_iFloatsPerVertex * sizeof(float)) == 0)
+		{
+			return iVertex;
+		}
+	}
+	return -1;
+}
+
+void MeshBuilder::vRehash(size_t uiBuckets)
+{
+	std::vector<uint32_t> table(uiBuckets, 0);
+	size_t uiMask = table.size() - 1;
+	for (int iVertex = 0; iVertex < iGetVertexCount(); iVertex++)
+	{
+		size_t uiBucket = uiHash(&m_vertices[(size_t)iVertex * m_iFloatsPerVertex]) & uiMask;
+		while (table[uiBucket] != 0)
+		{
+			uiBucket = (uiBucket + 1) & uiMask;
+		}
+		table[uiBucket] = (uint32_t)iVertex + 1;
+	}
+	m_table.swap(table);
+}
+
+bool MeshBuilder::bAddTriangles(const float* pfVertices, int iVertexCount)
+{
+	size_t uiIndicesAtEntry = m_indices.size();
+	size_t uiFloatsAtEntry = m_vertices.size();
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		const float* pfVertex = pfVertices + (size_t)i * m_iFloatsPerVertex;
+		uint32_t uiVertexHash = uiHash(pfVertex);
+		int iVertex = iFind(pfVertex, uiVertexHash);
+		if (iVertex < 0)
+		{
+			iVertex = iGetVertexCount();
+			if (iVertex > 0xFFFF)
+			{
+				std::cout << "ERROR::MESH::The mesh has more vertices than 16 bit indices can address" << std::endl;
+				/* Leave the mesh as it was before the call, not with half a triangle */
+				m_indices.resize(uiIndicesAtEntry);
+				m_vertices.resize(uiFloatsAtEntry);
+				vRehash(m_table.size());
+				return false;
+			}
+			m_vertices.insert(m_vertices.end(), pfVertex, pfVertex + m_iFloatsPerVertex);
+
+			/* Keep the table at most half full */
+			if ((size_t)iGetVertexCount() * 2 > m_table.size())
+			{
+				vRehash(m_table.size() * 2);
+			}
+			else
+			{
+				size_t uiMask = m_table.size() - 1;
+				size_t uiBucket = uiVertexHash & uiMask;
+				while (m_table[uiBucket] != 0)
+				{
+					uiBucket = (uiBucket + 1) & uiMask;
+				}
+				m_table[uiBucket] = (uint32_t)iVertex + 1;
+			}
+		}
+		m_indices.push_back((uint16_t)iVertex);
+	}
+	return true;
+}
+
+void MeshBuilder::vOptimize(int iCacheSize)
+{
+	int iVertexCount = iGetVertexCount();
+	size_t uiTriangleCount = m_indices.size() / 3;
+	if (uiTriangleCount == 0)
+	{
+		return;
+	}
+
+	/* Triangles around each vertex, and how many of them are still to be emitted */
+	std::vector<int> live(iVertexCount, 0);
+	for (size_t i = 0; i < uiTriangleCount * 3; i++)
+	{
+		live[m_indices[i]]++;
+	}
+	std::vector<size_t> offsets(iVertexCount + 1, 0);
+	for (int v = 0; v < iVertexCount; v++)
+	{
+		offsets[v + 1] = offsets[v] + live[v];
+	}
+	std::vector<size_t> adjacency(offsets[iVertexCount]);
+	std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < uiTriangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			adjacency[fill[m_indices[t * 3 + k]]++] = t;
+		}
+	}
+
+	/* Tipsify, Sander et al. 2007: fan around a vertex and continue with the
+	   neighbour that is most likely still in the cache */
+	std::vector<int> cacheTime(iVertexCount, 0);
+	std::vector<bool> emitted(uiTriangleCount, false);
+	std::vector<int> deadEnds;
+	std::vector<int> candidates;
+	std::vector<uint16_t> optimized;
+	optimized.reserve(m_indices.size());
+	int iTime = iCacheSize + 1;
+	int iCursor = 0;
+	int iFanning = 0;
+	while (iFanning >= 0)
+	{
+		candidates.clear();
+		for (size_t a = offsets[iFanning]; a < offsets[iFanning + 1]; a++)
+		{
+			size_t t = adjacency[a];
+			if (emitted[t])
+			{
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				int v = m_indices[t * 3 + k];
+				optimized.push_back((uint16_t)v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (iTime - cacheTime[v] > iCacheSize)
+				{
+					cacheTime[v] = iTime;
+					iTime++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		/* Prefer the candidate that stays in the cache while its remaining triangles are emitted */
+		int iNext = -1;
+		int iBest = -1;
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			int v = candidates[c];
+			if (live[v] > 0)
+			{
+				int iPriority = 0;
+				if (iTime - cacheTime[v] + 2 * live[v] <= iCacheSize)
+				{
+					iPriority = iTime - cacheTime[v];
+				}
+				if (iPriority > iBest)
+				{
+					iBest = iPriority;
+					iNext = v;
+				}
+			}
+		}
+
+		/* Dead end, go back to a recently used vertex or else the next one in input order */
+		while (iNext < 0 && !deadEnds.empty())
+		{
+			int v = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[v] > 0)
+			{
+				iNext = v;
+			}
+		}
+		while (iNext < 0 && iCursor < iVertexCount)
+		{
+			if (live[iCursor] > 0)
+			{
+				iNext = iCursor;
+			}
+			iCursor++;
+		}
+		iFanning = iNext;
+	}
+
+	/* Renumber the vertices in the order the new index buffer first uses them */
+	std::vector<int> remap(iVertexCount, -1);
+	std::vector<float> vertices(m_vertices.size());
+	int iNextVertex = 0;
+	for (size_t i = 0; i < optimized.size(); i++)
+	{
+		int v = optimized[i];
+		if (remap[v] < 0)
+		{
+			remap[v] = iNextVertex;
+			memcpy(&vertices[(size_t)iNextVertex * m_iFloatsPerVertex], &m_vertices[(size_t)v * m_iFloatsPerVertex], m_iFloatsPerVertex * sizeof(float));
+			iNextVertex++;
+		}
+		optimized[i] = (uint16_t)remap[v];
+	}
+	vertices.resize((size_t)iNextVertex * m_iFloatsPerVertex);
+	m_vertices.swap(vertices);
+	m_indices.swap(optimized);
+
+	/* The lookup table refers to the old numbering */
+	vRehash(m_table.size());
+}
+
+float MeshBuilder::fACMR(const uint16_t* puiIndices, size_t uiIndexCount, int iCacheSize)
+{
+	if (uiIndexCount < 3)
+	{
+		return 0.0f;
+	}
+	std::vector<int> cache(iCacheSize, -1);
+	size_t uiHead = 0;
+	size_t uiMisses = 0;
+	for (size_t i = 0; i < uiIndexCount; i++)
+	{
+		bool bHit = false;
+		for (int c = 0; c < iCacheSize; c++)
+		{
+			if (cache[c] == puiIndices[i])
+			{
+				bHit = true;
+				break;
+			}
+		}
+		if (!bHit)
+		{
+			cache[uiHead] = puiIndices[i];
+			uiHead = (uiHead + 1) % iCacheSize;
+			uiMisses++;
+		}
+	}
+	return (float)uiMisses / (float)(uiIndexCount / 3);
+}
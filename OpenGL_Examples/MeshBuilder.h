@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Turns a plain triangle list into an indexed mesh ready for glDrawElements.
+   Identical vertices are welded into one, the indices are 16 bit, and
+   vOptimize reorders the triangles for the post-transform vertex cache
+   (Tipsify) and then the vertices in the order they are first used, so
+   the vertex fetch walks the buffer mostly forward */
+class MeshBuilder
+{
+public:
+	explicit MeshBuilder(int iFloatsPerVertex);
+
+	/* Append iVertexCount vertices, every three of them form a triangle.
+	   Returns false and leaves the mesh unchanged if the welded mesh would not fit 16 bit indices */
+	bool bAddTriangles(const float* pfVertices, int iVertexCount);
+
+	void vOptimize(int iCacheSize = 16);
+
+	/* Average cache miss ratio, transformed vertices per triangle with a FIFO cache of the given size.
+	   Lies between 0.5 and 3.0, lower is better */
+	static float fACMR(const uint16_t* puiIndices, size_t uiIndexCount, int iCacheSize);
+
+	const std::vector<float>& getVertices() const { return m_vertices; }
+	const std::vector<uint16_t>& getIndices() const { return m_indices; }
+	int iGetVertexCount() const { return (int)(m_vertices.size() / m_iFloatsPerVertex); }
+	int iGetFloatsPerVertex() const { return m_iFloatsPerVertex; }
+
+private:
+	uint32_t uiHash(const float* pfVertex) const;
+	int iFind(const float* pfVertex, uint32_t uiHash) const;
+	void vRehash(size_t uiBuckets);
+
+	int m_iFloatsPerVertex;
+	std::vector<float> m_vertices;
+	std::vector<uint16_t> m_indices;
+
+	/* Open addressing table of vertex index + 1, zero marks a free bucket */
+	std::vector<uint32_t> m_table;
+};
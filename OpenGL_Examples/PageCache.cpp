@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <iterator>
+#include "PageCache.h"
+
+PageCache::PageCache(int iSlotsX, int iSlotsY, int iPagesX, int iPagesY)
+	: m_iSlotsX(iSlotsX), m_iSlotsY(iSlotsY), m_iPagesX(iPagesX), m_iPagesY(iPagesY), m_uiFrame(0), m_uiEvictions(0), m_bDirty(true)
+{
+	/* Mip levels go down to a single page, the same chain the page table texture has */
+	m_iMipCount = 1;
+	for (int iSize = std::max(iPagesX, iPagesY); iSize > 1; iSize >>= 1)
+	{
+		m_iMipCount++;
+	}
+	m_uiRootKey = uiPageKey(m_iMipCount - 1, 0, 0);
+
+	m_slots.resize((size_t)iSlotsX * iSlotsY);
+	for (int i = (int)m_slots.size() - 1; i >= 0; i--)
+	{
+		m_freeSlots.push_back(i);
+	}
+	m_pageTable.resize(m_iMipCount);
+	for (int iMip = 0; iMip < m_iMipCount; iMip++)
+	{
+		m_pageTable[iMip].resize((size_t)iGetPagesX(iMip) * iGetPagesY(iMip));
+	}
+}
+
+void PageCache::vBeginFrame()
+{
+	m_uiFrame++;
+	m_requested.clear();
+}
+
+void PageCache::vTouch(int iSlot)
+{
+	Slot& slot = m_slots[iSlot];
+	slot.uiLastUsed = m_uiFrame;
+	if (slot.uiKey != m_uiRootKey)
+	{
+		m_lru.splice(m_lru.begin(), m_lru, slot.lruPosition);
+	}
+}
+
+void PageCache::vRequest(uint32_t uiKey)
+{
+	int iMip = iKeyMip(uiKey);
+	int iX = iKeyX(uiKey);
+	int iY = iKeyY(uiKey);
+	if (iMip >= m_iMipCount)
+	{
+		return;
+	}
+
+	/* The ancestors are the fallback while the page itself is missing, keep them too */
+	for (; iMip < m_iMipCount; iMip++, iX >>= 1, iY >>= 1)
+	{
+		uint32_t uiPage = uiPageKey(iMip, iX, iY);
+		std::unordered_map<uint32_t, int>::iterator it = m_resident.find(uiPage);
+		if (it != m_resident.end())
+		{
+			if (m_slots[it->second].uiLastUsed == m_uiFrame)
+			{
+				break;
+			}
+			vTouch(it->second);
+		}
+		else
+		{
+			m_requested.insert(uiPage);
+		}
+	}
+}
+
+void PageCache::vCollectMissing(std::vector<uint32_t>& missing, size_t uiMax)
+{
+	missing.clear();
+	for (std::unordered_set<uint32_t>::const_iterator it = m_requested.begin(); it != m_requested.end(); ++it)
+	{
+		if (m_pending.count(*it) == 0 && m_resident.count(*it) == 0)
+		{
+			missing.push_back(*it);
+		}
+	}
+
+	/* Coarse pages first, they cover the most screen area per tile */
+	std::sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return iKeyMip(a) > iKeyMip(b) || (iKeyMip(a) == iKeyMip(b) && a < b); });
+	if (missing.size() > uiMax)
+	{
+		missing.resize(uiMax);
+	}
+	m_pending.insert(missing.begin(), missing.end());
+}
+
+int PageCache::iAllocateSlot(uint32_t uiKey)
+{
+	std::unordered_map<uint32_t, int>::iterator it = m_resident.find(uiKey);
+	if (it != m_resident.end())
+	{
+		return it->second;
+	}
+
+	int iSlot;
+	if (!m_freeSlots.empty())
+	{
+		iSlot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else
+	{
+		/* Never evict what the current frame still shows or what is still on its way to the GPU,
+		   take the least recently used slot that is neither */
+		std::list<int>::reverse_iterator victim = m_lru.rbegin();
+		while (victim != m_lru.rend() && (m_slots[*victim].uiLastUsed == m_uiFrame || !m_slots[*victim].bLoaded))
+		{
+			++victim;
+		}
+		if (victim == m_lru.rend())
+		{
+			return -1;
+		}
+		iSlot = *victim;
+		m_lru.erase(std::next(victim).base());
+		m_resident.erase(m_slots[iSlot].uiKey);
+		m_uiEvictions++;
+		m_bDirty = true;
+	}
+
+	Slot& slot = m_slots[iSlot];
+	slot.uiKey = uiKey;
+	slot.uiLastUsed = m_uiFrame;
+	slot.bLoaded = false;
+	if (uiKey != m_uiRootKey)
+	{
+		m_lru.push_front(iSlot);
+		slot.lruPosition = m_lru.begin();
+	}
+	m_resident[uiKey] = iSlot;
+	return iSlot;
+}
+
+void PageCache::vMarkResident(uint32_t uiKey)
+{
+	m_pending.erase(uiKey);
+	std::unordered_map<uint32_t, int>::iterator it = m_resident.find(uiKey);
+	if (it != m_resident.end())
+	{
+		m_slots[it->second].bLoaded = true;
+		m_bDirty = true;
+	}
+}
+
+void PageCache::vCancel(uint32_t uiKey)
+{
+	m_pending.erase(uiKey);
+	std::unordered_map<uint32_t, int>::iterator it = m_resident.find(uiKey);
+	if (it != m_resident.end() && !m_slots[it->second].bLoaded)
+	{
+		int iSlot = it->second;
+		if (uiKey != m_uiRootKey)
+		{
+			m_lru.erase(m_slots[iSlot].lruPosition);
+		}
+		m_resident.erase(it);
+		m_freeSlots.push_back(iSlot);
+	}
+}
+
+bool PageCache::bIsResident(uint32_t uiKey) const
+{
+	std::unordered_map<uint32_t, int>::const_iterator it = m_resident.find(uiKey);
+	return it != m_resident.end() && m_slots[it->second].bLoaded;
+}
+
+bool PageCache::bUpdatePageTable()
+{
+	if (!m_bDirty)
+	{
+		return false;
+	}
+
+	/* Walk from the coarsest level down, a missing page inherits the entry of its parent */
+	for (int iMip = m_iMipCount - 1; iMip >= 0; iMip--)
+	{
+		int iPagesX = iGetPagesX(iMip);
+		int iPagesY = iGetPagesY(iMip);
+		for (int iY = 0; iY < iPagesY; iY++)
+		{
+			for (int iX = 0; iX < iPagesX; iX++)
+			{
+				PageEntry& entry = m_pageTable[iMip][(size_t)iY * iPagesX + iX];
+				std::unordered_map<uint32_t, int>::const_iterator it = m_resident.find(uiPageKey(iMip, iX, iY));
+				if (it != m_resident.end() && m_slots[it->second].bLoaded)
+				{
+					entry.ucSlotX = (uint8_t)(it->second % m_iSlotsX);
+					entry.ucSlotY = (uint8_t)(it->second / m_iSlotsX);
+					entry.ucMip = (uint8_t)iMip;
+					entry.ucValid = 255;
+				}
+				else if (iMip + 1 < m_iMipCount)
+				{
+					int iParentPagesX = iGetPagesX(iMip + 1);
+					int iParentX = std::min(iX >> 1, iParentPagesX - 1);
+					int iParentY = std::min(iY >> 1, iGetPagesY(iMip + 1) - 1);
+					entry = m_pageTable[iMip + 1][(size_t)iParentY * iParentPagesX + iParentX];
+				}
+				else
+				{
+					entry.ucSlotX = 0;
+					entry.ucSlotY = 0;
+					entry.ucMip = 0;
+					entry.ucValid = 0;
+				}
+			}
+		}
+	}
+	m_bDirty = false;
+	return true;
+}
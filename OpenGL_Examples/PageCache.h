@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* CPU side residency of a virtual texture. The cache owns a fixed number of
+   physical tile slots, keeps them in least recently used order and mirrors
+   the page table: every page entry points to the finest resident page that
+   covers it. Nothing in here touches GL, so the policy can be exercised
+   without a context */
+class PageCache
+{
+public:
+	/* Page table entry as uploaded to the RGBA8 page table texture */
+	struct PageEntry
+	{
+		uint8_t ucSlotX;
+		uint8_t ucSlotY;
+		uint8_t ucMip;
+		uint8_t ucValid;
+	};
+
+	PageCache(int iSlotsX, int iSlotsY, int iPagesX, int iPagesY);
+
+	static uint32_t uiPageKey(int iMip, int iX, int iY) { return ((uint32_t)iMip << 24) | ((uint32_t)iY << 12) | (uint32_t)iX; }
+	static int iKeyMip(uint32_t uiKey) { return (int)(uiKey >> 24); }
+	static int iKeyX(uint32_t uiKey) { return (int)(uiKey & 0xFFF); }
+	static int iKeyY(uint32_t uiKey) { return (int)((uiKey >> 12) & 0xFFF); }
+
+	/* Start a new feedback frame, pages touched from now on are protected from eviction */
+	void vBeginFrame();
+
+	/* A page was seen in the feedback, keep it (and its missing ancestors) around */
+	void vRequest(uint32_t uiKey);
+
+	/* Missing pages to hand to the decoder, coarsest mips first, at most uiMax of them */
+	void vCollectMissing(std::vector<uint32_t>& missing, size_t uiMax);
+
+	/* Reserve a slot for a decoded page, evicting the least recently used loaded page the current frame does not use;
+	   -1 when there is none */
+	int iAllocateSlot(uint32_t uiKey);
+
+	/* The tile pixels of the page reached its slot, the page table may point at it now */
+	void vMarkResident(uint32_t uiKey);
+
+	/* Drop a pending request, e.g. when the decoder could not produce the tile */
+	void vCancel(uint32_t uiKey);
+
+	bool bIsResident(uint32_t uiKey) const;
+
+	/* Rebuild the page table mirror, false when nothing changed since the last call */
+	bool bUpdatePageTable();
+
+	int iGetMipCount() const { return m_iMipCount; }
+	int iGetPagesX(int iMip) const { return (m_iPagesX >> iMip) > 0 ? (m_iPagesX >> iMip) : 1; }
+	int iGetPagesY(int iMip) const { return (m_iPagesY >> iMip) > 0 ? (m_iPagesY >> iMip) : 1; }
+	int iGetSlotsX() const { return m_iSlotsX; }
+	int iGetSlotsY() const { return m_iSlotsY; }
+	const std::vector<PageEntry>& getPageTable(int iMip) const { return m_pageTable[iMip]; }
+	size_t uiGetResidentCount() const { return m_resident.size(); }
+	size_t uiGetEvictionCount() const { return m_uiEvictions; }
+
+private:
+	struct Slot
+	{
+		uint32_t uiKey;
+		uint64_t uiLastUsed;
+		bool bLoaded;
+		std::list<int>::iterator lruPosition;
+	};
+
+	void vTouch(int iSlot);
+
+	int m_iSlotsX;
+	int m_iSlotsY;
+	int m_iPagesX;
+	int m_iPagesY;
+	int m_iMipCount;
+	uint32_t m_uiRootKey;
+	uint64_t m_uiFrame;
+	size_t m_uiEvictions;
+	bool m_bDirty;
+
+	std::vector<Slot> m_slots;
+	std::list<int> m_lru;
+	std::vector<int> m_freeSlots;
+	std::unordered_map<uint32_t, int> m_resident;
+	std::unordered_set<uint32_t> m_requested;
+	std::unordered_set<uint32_t> m_pending;
+	std::vector<std::vector<PageEntry>> m_pageTable;
+};
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <iostream>
+#include "RenderQueue.h"
+
+uint64_t RenderQueue::uiMakeKey(GLuint uiProgram, int iMaterial, GLuint uiVertexArray, float fDepth)
+{
+	float fClamped = std::min(std::max(fDepth, 0.0f), 1.0f);
+	uint64_t uiDepth = (uint64_t)(fClamped * (float)0xFFFFFF);
+	return ((uint64_t)(uiProgram & 0xFFF) << 52)
+		| ((uint64_t)((iMaterial + 1) & 0xFFFF) << 36)
+		| ((uint64_t)(uiVertexArray & 0xFFF) << 24)
+		| uiDepth;
+}
+
+RenderQueue::RenderQueue()
+	: m_pItems(NULL), m_uiCount(0), m_uiCapacity(0)
+{
+}
+
+void RenderQueue::vBegin(FrameArena& arena, size_t uiCapacity)
+{
+	m_pItems = arena.pAllocateArray<DrawItem>(uiCapacity);
+	m_uiCount = 0;
+	m_uiCapacity = (m_pItems != NULL) ? uiCapacity : 0;
+}
+
+void RenderQueue::vPush(const DrawItem& item, float fDepth)
+{
+	if (m_uiCount == m_uiCapacity)
+	{
+		std::cout << "ERROR::RENDER_QUEUE::The queue holds " << m_uiCapacity << " items, a draw was dropped" << std::endl;
+		return;
+	}
+	DrawItem& stored = m_pItems[m_uiCount++];
+	stored = item;
+	stored.uiKey = uiMakeKey(item.pProgram->uiGetName(), item.iTexture, item.uiVertexArray, fDepth);
+}
+
+void RenderQueue::vRecord(CommandBuffer& commands)
+{
+	std::sort(m_pItems, m_pItems + m_uiCount, [](const DrawItem& a, const DrawItem& b) { return a.uiKey < b.uiKey; });
+
+	const DrawItem* pPrevious = NULL;
+	for (size_t i = 0; i < m_uiCount; i++)
+	{
+		const DrawItem& item = m_pItems[i];
+		if (pPrevious == NULL || pPrevious->pProgram != item.pProgram)
+		{
+			commands.vUseProgram(item.pProgram->uiGetName());
+		}
+		if (item.iTexture >= 0 && (pPrevious == NULL || pPrevious->iTexture != item.iTexture))
+		{
+			commands.vBindTexture(item.iTexture, GL_TEXTURE0);
+		}
+		if (pPrevious == NULL || pPrevious->uiVertexArray != item.uiVertexArray)
+		{
+			commands.vBindVertexArray(item.uiVertexArray);
+		}
+		commands.vDraw(item.mesh, item.uiInstanceCount, item.uiBaseInstance);
+		pPrevious = &item;
+	}
+}
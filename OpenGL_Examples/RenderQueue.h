@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <../../glad/include/glad/glad.h>
+#include "CommandBuffer.h"
+#include "FrameArena.h"
+#include "IndirectDraw.h"
+#include "ShaderProgram.h"
+
+/* One instanced draw of a mesh with everything it needs bound */
+struct DrawItem
+{
+	uint64_t uiKey;
+	const ShaderProgram* pProgram;
+	int iTexture;
+	GLuint uiVertexArray;
+	MeshRange mesh;
+	GLuint uiInstanceCount;
+	GLuint uiBaseInstance;
+};
+
+/* Collects the draws of a frame and records them sorted by state. The
+   key orders by program first, then material, vertex array and depth, so
+   items sharing the expensive state end up next to each other. State is
+   recorded only where it changes, so on replay runs of items with the same
+   state go out as one multi-draw indirect batch. The items live in the
+   frame arena. The queue makes no GL call, every recording thread can
+   own one */
+class RenderQueue
+{
+public:
+	/* Bits, from the top: 12 program, 16 material, 12 vertex array, 24 depth */
+	static uint64_t uiMakeKey(GLuint uiProgram, int iMaterial, GLuint uiVertexArray, float fDepth);
+
+	RenderQueue();
+
+	/* Start an empty list with room for uiCapacity items from this frame's arena */
+	void vBegin(FrameArena& arena, size_t uiCapacity);
+
+	/* Fills in the key from the item's state, fDepth is the normalized view depth, 0 is nearest.
+	   Items beyond the capacity are dropped */
+	void vPush(const DrawItem& item, float fDepth);
+
+	/* Sort the items and append their state and draws to the command buffer */
+	void vRecord(CommandBuffer& commands);
+
+	size_t uiGetItemCount() const { return m_uiCount; }
+
+private:
+	DrawItem* m_pItems;
+	size_t m_uiCount;
+	size_t m_uiCapacity;
+};
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cmath>
+#include "SceneStore.h"
+#include "TransformBatch.h"
+
+uint32_t SceneStore::uiAdd(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, float fLocalRadius)
+{
+	uint32_t uiObject = (uint32_t)m_positions.size();
+	m_positions.push_back(position);
+	m_rotations.push_back(rotation);
+	m_scales.push_back(scale);
+	m_localRadii.push_back(fLocalRadius);
+	m_world.push_back(glm::mat4());
+	m_bounds.vPush(position, fLocalRadius);
+	m_dirtyFlags.push_back(0);
+	vMarkDirty(uiObject);
+	return uiObject;
+}
+
+void SceneStore::vMarkDirty(uint32_t uiObject)
+{
+	if (!m_dirtyFlags[uiObject])
+	{
+		m_dirtyFlags[uiObject] = 1;
+		m_dirty.push_back(uiObject);
+	}
+}
+
+void SceneStore::vSetPosition(uint32_t uiObject, const glm::vec3& position)
+{
+	m_positions[uiObject] = position;
+	vMarkDirty(uiObject);
+}
+
+void SceneStore::vSetRotation(uint32_t uiObject, const glm::quat& rotation)
+{
+	m_rotations[uiObject] = rotation;
+	vMarkDirty(uiObject);
+}
+
+void SceneStore::vSetScale(uint32_t uiObject, const glm::vec3& scale)
+{
+	m_scales[uiObject] = scale;
+	vMarkDirty(uiObject);
+}
+
+void SceneStore::vUpdateBounds(uint32_t uiObject)
+{
+	const glm::vec3& position = m_positions[uiObject];
+	const glm::vec3& scale = m_scales[uiObject];
+	float fMaxScale = std::max(std::fabs(scale.x), std::max(std::fabs(scale.y), std::fabs(scale.z)));
+	m_bounds.x[uiObject] = position.x;
+	m_bounds.y[uiObject] = position.y;
+	m_bounds.z[uiObject] = position.z;
+	m_bounds.radius[uiObject] = m_localRadii[uiObject] * fMaxScale;
+}
+
+size_t SceneStore::uiUpdate()
+{
+	size_t uiChanged = m_dirty.size();
+	TransformBatch::vCompose(m_positions.data(), m_rotations.data(), m_scales.data(), m_dirty.data(), m_dirty.size(), m_world.data());
+	for (size_t i = 0; i < m_dirty.size(); i++)
+	{
+		vUpdateBounds(m_dirty[i]);
+		m_dirtyFlags[m_dirty[i]] = 0;
+	}
+	m_dirty.clear();
+	return uiChanged;
+}
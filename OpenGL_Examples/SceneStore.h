@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <../../glm/glm.hpp>
+#include <../../glm/gtc/quaternion.hpp>
+#include "FrustumCuller.h"
+
+/* Transforms of the scene objects as structure of arrays: positions,
+   rotations and scales each live in their own array, next to the cached
+   world matrices and bounding spheres. Setters only record the object as
+   dirty, vUpdate rebuilds the world matrix and bounds of the dirty ones,
+   so a frame in which nothing moved costs nothing */
+class SceneStore
+{
+public:
+	/* Returns the id of the object, ids are indices into every array */
+	uint32_t uiAdd(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, float fLocalRadius);
+
+	void vSetPosition(uint32_t uiObject, const glm::vec3& position);
+	void vSetRotation(uint32_t uiObject, const glm::quat& rotation);
+	void vSetScale(uint32_t uiObject, const glm::vec3& scale);
+
+	/* Rebuild what the setters invalidated. Returns how many objects changed, the bounds need a BVH refit if any did */
+	size_t uiUpdate();
+
+	size_t uiSize() const { return m_positions.size(); }
+	const glm::vec3& getPosition(uint32_t uiObject) const { return m_positions[uiObject]; }
+	const glm::quat& getRotation(uint32_t uiObject) const { return m_rotations[uiObject]; }
+	const glm::vec3& getScale(uint32_t uiObject) const { return m_scales[uiObject]; }
+	const std::vector<glm::vec3>& getPositions() const { return m_positions; }
+	const std::vector<glm::quat>& getRotations() const { return m_rotations; }
+	const std::vector<glm::vec3>& getScales() const { return m_scales; }
+	const std::vector<glm::mat4>& getWorld() const { return m_world; }
+	const BoundingSpheres& getBounds() const { return m_bounds; }
+
+private:
+	void vMarkDirty(uint32_t uiObject);
+	void vUpdateBounds(uint32_t uiObject);
+
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::quat> m_rotations;
+	std::vector<glm::vec3> m_scales;
+	std::vector<float> m_localRadii;
+
+	std::vector<glm::mat4> m_world;
+	BoundingSpheres m_bounds;
+
+	std::vector<uint8_t> m_dirtyFlags;
+	std::vector<uint32_t> m_dirty;
+};
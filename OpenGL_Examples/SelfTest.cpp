@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <../../glm/gtc/matrix_transform.hpp>
+#include "Bvh.h"
+#include "CommandBuffer.h"
+#include "FrameArena.h"
+#include "PageCache.h"
+#include "RenderQueue.h"
+#include "SelfTest.h"
+#include "TextureBudget.h"
+
+static bool bCheck(bool bCondition, const char* cTest, const char* cWhat)
+{
+	if (!bCondition)
+	{
+		std::cout << "ERROR::SELF_TEST::" << cTest << "::" << cWhat << std::endl;
+	}
+	return bCondition;
+}
+
+/* Same intersection as Bvh::iRaycast, over every sphere */
+static int iRaycastAll(const BoundingSpheres& spheres, const glm::vec3& origin, const glm::vec3& direction, float& fDistance)
+{
+	int iHit = -1;
+	fDistance = FLT_MAX;
+	for (size_t i = 0; i < spheres.uiSize(); i++)
+	{
+		glm::vec3 offset = origin - glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]);
+		float fB = glm::dot(offset, direction);
+		float fDiscriminant = fB * fB - (glm::dot(offset, offset) - spheres.radius[i] * spheres.radius[i]);
+		if (fDiscriminant < 0.0f)
+		{
+			continue;
+		}
+		float fRoot = std::sqrt(fDiscriminant);
+		float fT = (-fB - fRoot >= 0.0f) ? -fB - fRoot : -fB + fRoot;
+		if (fT >= 0.0f && fT < fDistance)
+		{
+			fDistance = fT;
+			iHit = (int)i;
+		}
+	}
+	return iHit;
+}
+
+static int iNearestAll(const BoundingSpheres& spheres, const glm::vec3& point, float& fDistance)
+{
+	int iNearest = -1;
+	fDistance = FLT_MAX;
+	for (size_t i = 0; i < spheres.uiSize(); i++)
+	{
+		glm::vec3 offset = point - glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]);
+		float fSurface = std::max(std::sqrt(glm::dot(offset, offset)) - spheres.radius[i], 0.0f);
+		if (fSurface < fDistance)
+		{
+			fDistance = fSurface;
+			iNearest = (int)i;
+		}
+	}
+	return iNearest;
+}
+
+/* Equal up to rounding, two objects at the same distance may both be the right answer */
+static bool bSameHit(int iHit, float fDistance, int iExpected, float fExpected)
+{
+	if (iHit < 0 || iExpected < 0)
+	{
+		return iHit == iExpected;
+	}
+	return iHit == iExpected || std::fabs(fDistance - fExpected) <= 1e-4f * std::max(1.0f, fExpected);
+}
+
+/* Whole tree and subtree by subtree, both have to keep exactly the spheres the culler keeps one by one */
+static bool bCullMatches(const Bvh& bvh, const BoundingSpheres& spheres, const FrustumCuller& culler)
+{
+	std::vector<uint32_t> expected;
+	for (size_t i = 0; i < spheres.uiSize(); i++)
+	{
+		if (culler.bSphereVisible(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]))
+		{
+			expected.push_back((uint32_t)i);
+		}
+	}
+	std::vector<uint32_t> visible(spheres.uiSize());
+	visible.resize(bvh.uiCull(culler, visible.data()));
+	std::sort(visible.begin(), visible.end());
+
+	uint32_t auiRoots[16];
+	size_t uiRoots = bvh.uiGetSubtrees(auiRoots, 16);
+	std::vector<uint32_t> subtrees(spheres.uiSize());
+	size_t uiSubtreeVisible = 0;
+	uint32_t uiNextObject = 0;
+	bool bRangesTile = true;
+	for (size_t r = 0; r < uiRoots; r++)
+	{
+		uint32_t uiFirst, uiCount;
+		bvh.vGetObjectRange(auiRoots[r], uiFirst, uiCount);
+		bRangesTile &= uiFirst == uiNextObject;
+		uiNextObject = uiFirst + uiCount;
+		uiSubtreeVisible += bvh.uiCullSubtree(culler, auiRoots[r], subtrees.data() + uiSubtreeVisible);
+	}
+	subtrees.resize(uiSubtreeVisible);
+	std::sort(subtrees.begin(), subtrees.end());
+	return visible == expected && subtrees == expected && bRangesTile && uiNextObject == spheres.uiSize();
+}
+
+/* The rejected streams are expected, their ERROR lines are not printed */
+static bool bValidateQuietly(const CommandBuffer& commands, GLuint uiFirstInstance, GLuint uiEndInstance)
+{
+	std::ostringstream discarded;
+	std::streambuf* pOutput = std::cout.rdbuf(discarded.rdbuf());
+	bool bValid = commands.bValidate(uiFirstInstance, uiEndInstance);
+	std::cout.rdbuf(pOutput);
+	return bValid;
+}
+
+bool SelfTest::bRunAll()
+{
+	bool bPassed = true;
+	bPassed &= bPageCache();
+	bPassed &= bTextureBudget();
+	bPassed &= bCommandBuffer();
+	bPassed &= bBvh();
+	std::cout << "Self test " << (bPassed ? "passed" : "failed") << std::endl;
+	return bPassed;
+}
+
+bool SelfTest::bPageCache()
+{
+	const char* cTest = "PAGE_CACHE";
+	bool bPassed = true;
+
+	/* 4x4 pages give the mips 4x4, 2x2 and 1x1, three slots hold the root and two more pages */
+	PageCache cache(3, 1, 4, 4);
+	uint32_t uiRoot = PageCache::uiPageKey(2, 0, 0);
+	uint32_t uiParent = PageCache::uiPageKey(1, 0, 0);
+	uint32_t uiPage = PageCache::uiPageKey(0, 1, 1);
+	bPassed &= bCheck(cache.iGetMipCount() == 3, cTest, "The mip chain does not end at a single page");
+
+	/* A request brings in the page with all of its ancestors, the coarsest first */
+	std::vector<uint32_t> missing;
+	cache.vBeginFrame();
+	cache.vRequest(uiPage);
+	cache.vCollectMissing(missing, 16);
+	bPassed &= bCheck(missing.size() == 3 && missing[0] == uiRoot && missing[1] == uiParent && missing[2] == uiPage, cTest, "Missing pages are not the page and its ancestors, coarsest first");
+	cache.vCollectMissing(missing, 16);
+	bPassed &= bCheck(missing.empty(), cTest, "A pending page is requested twice");
+
+	/* Until it is resident the page table falls back to the parent, then to the page itself */
+	int iRootSlot = cache.iAllocateSlot(uiRoot);
+	int iParentSlot = cache.iAllocateSlot(uiParent);
+	int iPageSlot = cache.iAllocateSlot(uiPage);
+	bPassed &= bCheck(iRootSlot >= 0 && iParentSlot >= 0 && iPageSlot >= 0, cTest, "Free slots are not handed out");
+	cache.vMarkResident(uiRoot);
+	cache.vMarkResident(uiParent);
+	cache.bUpdatePageTable();
+	const PageCache::PageEntry& entry = cache.getPageTable(0)[1 * 4 + 1];
+	bPassed &= bCheck(entry.ucValid != 0 && entry.ucMip == 1 && entry.ucSlotX == iParentSlot, cTest, "A missing page does not point at its resident parent");
+	cache.vMarkResident(uiPage);
+	bPassed &= bCheck(cache.bUpdatePageTable(), cTest, "A new resident page leaves the page table clean");
+	bPassed &= bCheck(entry.ucMip == 0 && entry.ucSlotX == iPageSlot, cTest, "A resident page does not point at its own slot");
+	bPassed &= bCheck(cache.getPageTable(0)[0].ucMip == 1, cTest, "A sibling does not fall back to the shared parent");
+
+	/* Everything is in use this frame, nothing may be evicted */
+	bPassed &= bCheck(cache.iAllocateSlot(PageCache::uiPageKey(0, 3, 3)) == -1, cTest, "A page of the current frame was evicted");
+
+	/* In the next frame the least recently used page goes, never the root */
+	cache.vBeginFrame();
+	cache.vRequest(uiParent);
+	bPassed &= bCheck(cache.iAllocateSlot(PageCache::uiPageKey(0, 3, 3)) == iPageSlot, cTest, "The least recently used page was not evicted");
+	bPassed &= bCheck(!cache.bIsResident(uiPage) && cache.bIsResident(uiRoot) && cache.bIsResident(uiParent), cTest, "The wrong pages are resident after an eviction");
+	bPassed &= bCheck(cache.uiGetEvictionCount() == 1, cTest, "The eviction was not counted");
+
+	/* The least recently used page is still pending, the next older loaded one is evicted instead */
+	PageCache pending(2, 1, 4, 4);
+	uint32_t uiPending = PageCache::uiPageKey(1, 0, 0);
+	uint32_t uiLoaded = PageCache::uiPageKey(1, 1, 0);
+	pending.vBeginFrame();
+	int iPendingSlot = pending.iAllocateSlot(uiPending);
+	int iLoadedSlot = pending.iAllocateSlot(uiLoaded);
+	pending.vMarkResident(uiLoaded);
+	pending.vBeginFrame();
+	bPassed &= bCheck(pending.iAllocateSlot(PageCache::uiPageKey(1, 0, 1)) == iLoadedSlot, cTest, "A pending page at the end of the LRU order blocked the eviction");
+	bPassed &= bCheck(!pending.bIsResident(uiLoaded), cTest, "The evicted page is still resident");
+
+	/* Nothing but pending pages left, so no slot until one of them is cancelled */
+	bPassed &= bCheck(pending.iAllocateSlot(uiLoaded) == -1, cTest, "A pending page was evicted");
+	pending.vCancel(uiPending);
+	bPassed &= bCheck(pending.iAllocateSlot(uiLoaded) == iPendingSlot, cTest, "A cancelled page keeps its slot");
+	return bPassed;
+}
+
+bool SelfTest::bTextureBudget()
+{
+	const char* cTest = "TEXTURE_BUDGET";
+	bool bPassed = true;
+
+	/* Three 64x64 RGBA8 textures with 7 levels each, registered as not loaded yet */
+	const int iLevels = 7;
+	size_t uiFull = 0;
+	for (int iLevel = 0; iLevel < iLevels; iLevel++)
+	{
+		uiFull += TextureBudget::uiLevelBytes(64, 64, 1, 4, iLevel);
+	}
+	size_t uiTopMip = TextureBudget::uiLevelBytes(64, 64, 1, 4, 0);
+	TextureBudget budget(3 * uiFull);
+	int iOldest = budget.iRegister(64, 64, 1, iLevels, 4, iLevels);
+	int iMiddle = budget.iRegister(64, 64, 1, iLevels, 4, iLevels);
+	int iNewest = budget.iRegister(64, 64, 1, iLevels, 4, iLevels);
+	std::vector<TextureBudget::Change> changes;
+
+	/* Bound textures are loaded completely while they fit */
+	budget.vBeginFrame();
+	budget.vTouch(iOldest);
+	budget.vTouch(iMiddle);
+	budget.vTouch(iNewest);
+	budget.vBalance(changes);
+	bPassed &= bCheck(changes.size() == 3 && budget.uiGetResidentBytes() == 3 * uiFull, cTest, "Bound textures were not loaded");
+	bPassed &= bCheck(changes[0].iOldBase == iLevels && changes[0].iNewBase == 0, cTest, "A load does not report the old and new base level");
+
+	/* Over budget, the least recently bound texture gives up its top mip first */
+	budget.vBeginFrame();
+	budget.vTouch(iMiddle);
+	budget.vTouch(iNewest);
+	budget.vBeginFrame();
+	budget.vTouch(iNewest);
+	budget.vSetBudget(3 * uiFull - uiTopMip);
+	budget.vBalance(changes);
+	bPassed &= bCheck(changes.size() == 1 && changes[0].iHandle == iOldest && budget.iGetResidentBase(iOldest) == 1, cTest, "The least recently bound texture did not lose its top mip");
+	bPassed &= bCheck(budget.iGetResidentBase(iMiddle) == 0 && budget.iGetResidentBase(iNewest) == 0, cTest, "A more recently bound texture lost a level");
+	bPassed &= bCheck(budget.uiGetResidentBytes() <= budget.uiGetBudget(), cTest, "The budget is exceeded after an eviction");
+
+	/* The oldest goes out completely before the next one loses a level, the current one is kept */
+	budget.vSetBudget(2 * uiFull - uiTopMip);
+	budget.vBalance(changes);
+	bPassed &= bCheck(budget.iGetResidentBase(iOldest) == iLevels, cTest, "The least recently bound texture was not evicted completely");
+	bPassed &= bCheck(budget.iGetResidentBase(iMiddle) == 1 && budget.iGetResidentBase(iNewest) == 0, cTest, "Evictions did not follow the binding order");
+
+	/* Bound again with room to spare, both come back to full resolution */
+	budget.vSetBudget(3 * uiFull);
+	budget.vBeginFrame();
+	budget.vTouch(iOldest);
+	budget.vTouch(iMiddle);
+	budget.vBalance(changes);
+	bPassed &= bCheck(budget.iGetResidentBase(iOldest) == 0 && budget.iGetResidentBase(iMiddle) == 0, cTest, "Bound textures were not restored");
+	bPassed &= bCheck(changes.size() == 2 && budget.uiGetResidentBytes() == 3 * uiFull, cTest, "The restore is not accounted");
+
+	/* A pinned texture keeps its levels even when it is the least recently bound one */
+	budget.vSetPinned(iNewest, true);
+	budget.vBeginFrame();
+	budget.vTouch(iOldest);
+	budget.vBeginFrame();
+	budget.vSetBudget(2 * uiFull);
+	budget.vBalance(changes);
+	bPassed &= bCheck(budget.iGetResidentBase(iNewest) == 0, cTest, "A pinned texture was evicted");
+	bPassed &= bCheck(budget.iGetResidentBase(iMiddle) == iLevels && budget.iGetResidentBase(iOldest) == 0, cTest, "The unpinned textures were not evicted in binding order");
+
+	/* Nothing but pinned and bound textures left, the budget is exceeded instead */
+	budget.vBeginFrame();
+	budget.vTouch(iOldest);
+	budget.vSetBudget(uiFull);
+	budget.vBalance(changes);
+	bPassed &= bCheck(changes.empty() && budget.uiGetResidentBytes() == 2 * uiFull, cTest, "A pinned or bound texture was evicted to meet the budget");
+
+	/* Unpinned it is the first to go */
+	budget.vSetPinned(iNewest, false);
+	budget.vBalance(changes);
+	bPassed &= bCheck(budget.iGetResidentBase(iNewest) == iLevels && budget.iGetResidentBase(iOldest) == 0, cTest, "An unpinned texture was not evicted");
+	return bPassed;
+}
+
+bool SelfTest::bCommandBuffer()
+{
+	const char* cTest = "COMMAND_BUFFER";
+	bool bPassed = true;
+
+	/* A partition of the frame like the render thread records it: instances 100 to 115, cubes and pyramids */
+	FrameArena arena(4096, 1);
+	arena.vBeginFrame();
+	ShaderProgram program;
+	program.m_uiProgram = 3;
+	MeshRange cube = { 36, 0, 0 };
+	MeshRange pyramid = { 18, 36, 24 };
+	DrawItem cubes = { 0, &program, 0, 1, cube, 10, 100 };
+	DrawItem pyramids = { 0, &program, 0, 1, pyramid, 5, 110 };
+	RenderQueue queue;
+	queue.vBegin(arena, 4);
+	queue.vPush(cubes, 0.5f);
+	queue.vPush(pyramids, 0.25f);
+	CommandBuffer commands;
+	queue.vRecord(commands);
+	bPassed &= bCheck(commands.uiGetCommandCount() == 5, cTest, "The queue did not record program, texture, vertex array and two draws");
+	bPassed &= bCheck(bValidateQuietly(commands, 100, 115), cTest, "A well formed partition was rejected");
+
+	/* Draws reading instances of another partition */
+	bPassed &= bCheck(!bValidateQuietly(commands, 101, 115), cTest, "A base instance before the partition was accepted");
+	bPassed &= bCheck(!bValidateQuietly(commands, 100, 114), cTest, "Instances past the end of the partition were accepted");
+
+	/* A program that was never linked has no name, its draws have no program bound */
+	ShaderProgram unlinked;
+	DrawItem unbound = cubes;
+	unbound.pProgram = &unlinked;
+	queue.vBegin(arena, 1);
+	queue.vPush(unbound, 0.5f);
+	CommandBuffer noProgram;
+	queue.vRecord(noProgram);
+	bPassed &= bCheck(!bValidateQuietly(noProgram, 100, 115), cTest, "A draw without a program was accepted");
+
+	CommandBuffer noVertexArray;
+	noVertexArray.vUseProgram(3);
+	noVertexArray.vDraw(cube, 10, 100);
+	bPassed &= bCheck(!bValidateQuietly(noVertexArray, 100, 115), cTest, "A draw without a vertex array was accepted");
+
+	/* Cut off in the middle of the last draw, and cut off in the middle of a header */
+	CommandBuffer truncated = commands;
+	truncated.m_arena.pop_back();
+	bPassed &= bCheck(!bValidateQuietly(truncated, 100, 115), cTest, "A truncated command was accepted");
+	truncated.m_arena.resize(commands.m_arena.size() + 1);
+	bPassed &= bCheck(!bValidateQuietly(truncated, 100, 115), cTest, "A truncated header was accepted");
+
+	/* A header with an opcode past the last one */
+	CommandBuffer unknown = commands;
+	CommandBuffer::Header header = { (uint16_t)CommandBuffer::OP_COUNT, 0 };
+	const unsigned char* pucHeader = (const unsigned char*)&header;
+	unknown.m_arena.insert(unknown.m_arena.end(), pucHeader, pucHeader + sizeof(header));
+	unknown.m_uiCommands++;
+	bPassed &= bCheck(!bValidateQuietly(unknown, 100, 115), cTest, "An unknown opcode was accepted");
+	return bPassed;
+}
+
+bool SelfTest::bBvh()
+{
+	const char* cTest = "BVH";
+	bool bPassed = true;
+
+	/* Few enough objects that the tree is built on this thread, enough for several levels */
+	const size_t uiObjects = 2000;
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> radius(0.2f, 2.0f);
+	BoundingSpheres spheres;
+	for (size_t i = 0; i < uiObjects; i++)
+	{
+		spheres.vPush(glm::vec3(position(random), position(random), position(random)), radius(random));
+	}
+	Bvh bvh;
+	bvh.vBuild(spheres);
+
+	FrustumCuller culler;
+	culler.vSetViewProjection(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 60.0f)
+		* glm::lookAt(glm::vec3(0.0f, 0.0f, 40.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+	for (int iPass = 0; iPass < 2; iPass++)
+	{
+		/* The second pass moves every object and refits the tree instead of building it again */
+		if (iPass == 1)
+		{
+			std::uniform_real_distribution<float> move(-5.0f, 5.0f);
+			for (size_t i = 0; i < uiObjects; i++)
+			{
+				spheres.x[i] += move(random);
+				spheres.y[i] += move(random);
+				spheres.z[i] += move(random);
+			}
+			bvh.vRefit(spheres);
+		}
+		const char* cRaycast = (iPass == 0) ? "A raycast does not hit the closest sphere" : "A raycast does not hit the closest sphere after a refit";
+		const char* cNearest = (iPass == 0) ? "The nearest object is not the closest one" : "The nearest object is not the closest one after a refit";
+		const char* cCull = (iPass == 0) ? "Culling does not keep the visible spheres" : "Culling does not keep the visible spheres after a refit";
+
+		bool bRaycast = true;
+		bool bNearest = true;
+		for (int i = 0; i < 200; i++)
+		{
+			glm::vec3 origin(position(random), position(random), position(random));
+			glm::vec3 direction = glm::normalize(glm::vec3(position(random), position(random), position(random)) - origin);
+			float fDistance, fExpected;
+			int iHit = bvh.iRaycast(origin, direction, fDistance);
+			int iExpected = iRaycastAll(spheres, origin, direction, fExpected);
+			bRaycast &= bSameHit(iHit, fDistance, iExpected, fExpected);
+
+			iHit = bvh.iNearest(origin, fDistance);
+			iExpected = iNearestAll(spheres, origin, fExpected);
+			bNearest &= bSameHit(iHit, fDistance, iExpected, fExpected);
+		}
+		bPassed &= bCheck(bRaycast, cTest, cRaycast);
+		bPassed &= bCheck(bNearest, cTest, cNearest);
+		bPassed &= bCheck(bCullMatches(bvh, spheres, culler), cTest, cCull);
+	}
+
+	Bvh empty;
+	float fDistance;
+	bPassed &= bCheck(empty.iRaycast(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), fDistance) == -1 && empty.iNearest(glm::vec3(0.0f), fDistance) == -1, cTest, "An empty tree returns an object");
+	return bPassed;
+}
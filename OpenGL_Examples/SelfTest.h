@@ -0,0 +1,22 @@
+#pragma once
+
+/* Checks of the policy classes that make no GL call, so they run without
+   a context. Every failed check prints an ERROR line, every function
+   returns whether all of its checks passed */
+class SelfTest
+{
+public:
+	static bool bRunAll();
+
+	/* Slot allocation, LRU eviction and the page table of PageCache */
+	static bool bPageCache();
+
+	/* Eviction order, mip drop and restore and pinning of TextureBudget */
+	static bool bTextureBudget();
+
+	/* bValidate of CommandBuffer on a stream recorded by RenderQueue and on broken ones */
+	static bool bCommandBuffer();
+
+	/* Raycast, nearest object and culling of Bvh against brute force, before and after a refit */
+	static bool bBvh();
+};
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <vector>
+#include <../../glm/gtc/type_ptr.hpp>
+#include "ShaderProgram.h"
+
+/* Function local tables, so names can be interned from static initializers of other files */
+static std::unordered_map<std::string, UniformName>& getInternTable()
+{
+	static std::unordered_map<std::string, UniformName> table;
+	return table;
+}
+
+static std::vector<std::string>& getInternNames()
+{
+	static std::vector<std::string> names;
+	return names;
+}
+
+ShaderProgram::ShaderProgram()
+	: m_uiProgram(0)
+{
+}
+
+UniformName ShaderProgram::uiIntern(const char* cName)
+{
+	std::unordered_map<std::string, UniformName>& table = getInternTable();
+	std::unordered_map<std::string, UniformName>::const_iterator it = table.find(cName);
+	if (it != table.end())
+	{
+		return it->second;
+	}
+	UniformName uiName = (UniformName)getInternNames().size();
+	getInternNames().push_back(cName);
+	table[cName] = uiName;
+	return uiName;
+}
+
+const std::string& ShaderProgram::getName(UniformName uiName)
+{
+	return getInternNames()[uiName];
+}
+
+void ShaderProgram::vCreate(GLuint uiProgram)
+{
+	vRelease();
+	m_uiProgram = uiProgram;
+	if (m_uiProgram == 0)
+	{
+		return;
+	}
+
+	GLint iCount = 0;
+	GLint iMaxLength = 0;
+	glGetProgramiv(m_uiProgram, GL_ACTIVE_UNIFORMS, &iCount);
+	glGetProgramiv(m_uiProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &iMaxLength);
+	std::vector<char> name(iMaxLength + 1);
+	for (GLint i = 0; i < iCount; i++)
+	{
+		GLsizei iLength = 0;
+		GLint iSize = 0;
+		GLenum eType = 0;
+		glGetActiveUniform(m_uiProgram, (GLuint)i, (GLsizei)name.size(), &iLength, &iSize, &eType, name.data());
+
+		/* Arrays are reported as "name[0]", they are set through their base name */
+		std::string sName(name.data(), iLength);
+		if (sName.size() > 3 && sName.compare(sName.size() - 3, 3, "[0]") == 0)
+		{
+			sName.resize(sName.size() - 3);
+		}
+
+		/* Members of uniform blocks have no location */
+		GLint iLocation = glGetUniformLocation(m_uiProgram, sName.c_str());
+		if (iLocation >= 0)
+		{
+			m_locations[uiIntern(sName.c_str())] = iLocation;
+		}
+	}
+	std::cout << "Shader program " << m_uiProgram << ": " << m_locations.size() << " active uniforms" << std::endl;
+}
+
+void ShaderProgram::vRelease()
+{
+	if (m_uiProgram)
+	{
+		glDeleteProgram(m_uiProgram);
+		m_uiProgram = 0;
+	}
+	m_locations.clear();
+}
+
+GLint ShaderProgram::iLocation(UniformName uiName) const
+{
+	std::unordered_map<UniformName, GLint>::const_iterator it = m_locations.find(uiName);
+	return (it != m_locations.end()) ? it->second : -1;
+}
+
+void ShaderProgram::vSetInt(UniformName uiName, int iValue) const
+{
+	glProgramUniform1i(m_uiProgram, iLocation(uiName), iValue);
+}
+
+void ShaderProgram::vSetFloat(UniformName uiName, float fValue) const
+{
+	glProgramUniform1f(m_uiProgram, iLocation(uiName), fValue);
+}
+
+void ShaderProgram::vSetVec2(UniformName uiName, const glm::vec2& value) const
+{
+	glProgramUniform2f(m_uiProgram, iLocation(uiName), value.x, value.y);
+}
+
+void ShaderProgram::vSetVec4(UniformName uiName, const glm::vec4& value) const
+{
+	glProgramUniform4f(m_uiProgram, iLocation(uiName), value.x, value.y, value.z, value.w);
+}
+
+void ShaderProgram::vSetMat4(UniformName uiName, const glm::mat4& value) const
+{
+	glProgramUniformMatrix4fv(m_uiProgram, iLocation(uiName), 1, GL_FALSE, glm::value_ptr(value));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <../../glad/include/glad/glad.h>
+#include <../../glm/glm.hpp>
+
+/* Interned uniform name, the same string always maps to the same id */
+typedef uint32_t UniformName;
+
+/* Linked program with its active uniforms reflected once after linking.
+   The locations are cached by interned name, so setting a uniform in the
+   render loop is a hash lookup on an integer instead of a string search
+   in the driver. Setters go through glProgramUniform and do not depend on
+   the bound program */
+class ShaderProgram
+{
+public:
+	ShaderProgram();
+
+	static UniformName uiIntern(const char* cName);
+	static const std::string& getName(UniformName uiName);
+
+	/* Take ownership of a linked program and reflect its uniforms */
+	void vCreate(GLuint uiProgram);
+	void vRelease();
+
+	void vUse() const { glUseProgram(m_uiProgram); }
+	GLuint uiGetName() const { return m_uiProgram; }
+
+	/* -1 for names that are not an active uniform, the setters ignore those like GL does */
+	GLint iLocation(UniformName uiName) const;
+
+	void vSetInt(UniformName uiName, int iValue) const;
+	void vSetFloat(UniformName uiName, float fValue) const;
+	void vSetVec2(UniformName uiName, const glm::vec2& value) const;
+	void vSetVec4(UniformName uiName, const glm::vec4& value) const;
+	void vSetMat4(UniformName uiName, const glm::mat4& value) const;
+
+private:
+	/* Gives programs a name without linking them, for recording without a context */
+	friend class SelfTest;
+
+	GLuint m_uiProgram;
+	std::unordered_map<UniformName, GLint> m_locations;
+};
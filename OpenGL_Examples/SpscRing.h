@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+/* Lock free ring buffer for exactly one producer and one consumer thread.
+   The producer only writes the head and the consumer only the tail, each
+   publishes its index with release and reads the other one with acquire,
+   so an element is fully written before the consumer can see it. The
+   capacity has to be a power of two; a full ring rejects new elements
+   instead of blocking the producer */
+template <typename T, size_t N>
+class SpscRing
+{
+	static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing capacity has to be a power of two");
+
+public:
+	SpscRing()
+		: m_uiHead(0), m_uiTail(0)
+	{
+	}
+
+	/* Producer side, returns false if the consumer is N elements behind */
+	bool bPush(const T& element)
+	{
+		size_t uiHead = m_uiHead.load(std::memory_order_relaxed);
+		if (uiHead - m_uiTail.load(std::memory_order_acquire) == N)
+		{
+			return false;
+		}
+		m_aElements[uiHead & (N - 1)] = element;
+		m_uiHead.store(uiHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* Consumer side, returns false if the ring is empty */
+	bool bPop(T& element)
+	{
+		size_t uiTail = m_uiTail.load(std::memory_order_relaxed);
+		if (uiTail == m_uiHead.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		element = m_aElements[uiTail & (N - 1)];
+		m_uiTail.store(uiTail + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T m_aElements[N];
+	/* Kept on separate cache lines, the two threads would otherwise fight over one */
+	alignas(64) std::atomic<size_t> m_uiHead;
+	alignas(64) std::atomic<size_t> m_uiTail;
+};
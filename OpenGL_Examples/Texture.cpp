@@ -0,0 +1,131 @@
+#include <cstddef>
+#include "Texture.h"
+
+Texture::Texture()
+	: m_uiName(0), m_eTarget(GL_TEXTURE_2D), m_iWidth(0), m_iHeight(0), m_iLayers(0), m_iLevels(0)
+{
+}
+
+Texture::~Texture()
+{
+	vRelease();
+}
+
+Texture::Texture(Texture&& other)
+	: m_uiName(other.m_uiName), m_eTarget(other.m_eTarget), m_iWidth(other.m_iWidth), m_iHeight(other.m_iHeight), m_iLayers(other.m_iLayers), m_iLevels(other.m_iLevels)
+{
+	other.m_uiName = 0;
+}
+
+Texture& Texture::operator=(Texture&& other)
+{
+	if (this != &other)
+	{
+		vRelease();
+		m_uiName = other.m_uiName;
+		m_eTarget = other.m_eTarget;
+		m_iWidth = other.m_iWidth;
+		m_iHeight = other.m_iHeight;
+		m_iLayers = other.m_iLayers;
+		m_iLevels = other.m_iLevels;
+		other.m_uiName = 0;
+	}
+	return *this;
+}
+
+int Texture::iMipLevelCount(int iWidth, int iHeight)
+{
+	int iSize = (iWidth > iHeight) ? iWidth : iHeight;
+	int iLevels = 1;
+	while (iSize > 1)
+	{
+		iSize >>= 1;
+		iLevels++;
+	}
+	return iLevels;
+}
+
+void Texture::vDownsampleRGBA8(const unsigned char* pucSrc, int iWidth, int iHeight, unsigned char* pucDst)
+{
+	int iDstWidth = (iWidth / 2 > 0) ? iWidth / 2 : 1;
+	int iDstHeight = (iHeight / 2 > 0) ? iHeight / 2 : 1;
+	for (int y = 0; y < iDstHeight; y++)
+	{
+		int iY0 = (2 * y < iHeight) ? 2 * y : iHeight - 1;
+		int iY1 = (2 * y + 1 < iHeight) ? 2 * y + 1 : iHeight - 1;
+		for (int x = 0; x < iDstWidth; x++)
+		{
+			int iX0 = (2 * x < iWidth) ? 2 * x : iWidth - 1;
+			int iX1 = (2 * x + 1 < iWidth) ? 2 * x + 1 : iWidth - 1;
+			for (int c = 0; c < 4; c++)
+			{
+				int iSum = pucSrc[((size_t)iY0 * iWidth + iX0) * 4 + c] + pucSrc[((size_t)iY0 * iWidth + iX1) * 4 + c]
+					+ pucSrc[((size_t)iY1 * iWidth + iX0) * 4 + c] + pucSrc[((size_t)iY1 * iWidth + iX1) * 4 + c];
+				pucDst[((size_t)y * iDstWidth + x) * 4 + c] = (unsigned char)((iSum + 2) / 4);
+			}
+		}
+	}
+}
+
+void Texture::vCreate2D(int iWidth, int iHeight, int iLevels, GLenum eInternalFormat)
+{
+	vRelease();
+	m_eTarget = GL_TEXTURE_2D;
+	m_iWidth = iWidth;
+	m_iHeight = iHeight;
+	m_iLayers = 1;
+	m_iLevels = iLevels;
+	glGenTextures(1, &m_uiName);
+	glBindTexture(m_eTarget, m_uiName);
+	glTexStorage2D(m_eTarget, iLevels, eInternalFormat, iWidth, iHeight);
+}
+
+void Texture::vCreate2DArray(int iWidth, int iHeight, int iLayers, int iLevels, GLenum eInternalFormat)
+{
+	vRelease();
+	m_eTarget = GL_TEXTURE_2D_ARRAY;
+	m_iWidth = iWidth;
+	m_iHeight = iHeight;
+	m_iLayers = iLayers;
+	m_iLevels = iLevels;
+	glGenTextures(1, &m_uiName);
+	glBindTexture(m_eTarget, m_uiName);
+	glTexStorage3D(m_eTarget, iLevels, eInternalFormat, iWidth, iHeight, iLayers);
+}
+
+void Texture::vSetSampling(GLenum eWrap, GLenum eMinFilter, GLenum eMagFilter)
+{
+	glBindTexture(m_eTarget, m_uiName);
+	glTexParameteri(m_eTarget, GL_TEXTURE_WRAP_S, eWrap);
+	glTexParameteri(m_eTarget, GL_TEXTURE_WRAP_T, eWrap);
+	glTexParameteri(m_eTarget, GL_TEXTURE_MIN_FILTER, eMinFilter);
+	glTexParameteri(m_eTarget, GL_TEXTURE_MAG_FILTER, eMagFilter);
+}
+
+void Texture::vSubImage(int iLevel, int iLayer, int iWidth, int iHeight, GLenum eFormat, const void* pData)
+{
+	glBindTexture(m_eTarget, m_uiName);
+	if (m_eTarget == GL_TEXTURE_2D_ARRAY)
+	{
+		glTexSubImage3D(m_eTarget, iLevel, 0, 0, iLayer, iWidth, iHeight, 1, eFormat, GL_UNSIGNED_BYTE, pData);
+	}
+	else
+	{
+		glTexSubImage2D(m_eTarget, iLevel, 0, 0, iWidth, iHeight, eFormat, GL_UNSIGNED_BYTE, pData);
+	}
+}
+
+void Texture::vBind(GLenum eUnit) const
+{
+	glActiveTexture(eUnit);
+	glBindTexture(m_eTarget, m_uiName);
+}
+
+void Texture::vRelease()
+{
+	if (m_uiName)
+	{
+		glDeleteTextures(1, &m_uiName);
+		m_uiName = 0;
+	}
+}
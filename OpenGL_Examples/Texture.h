@@ -0,0 +1,47 @@
+#pragma once
+#include <../../glad/include/glad/glad.h>
+
+/* Owner of one GL texture name with immutable storage. All mip levels are
+   allocated up front with glTexStorage, so the driver never has to
+   reallocate or revalidate the texture when the levels are filled later */
+class Texture
+{
+public:
+	Texture();
+	~Texture();
+	Texture(Texture&& other);
+	Texture& operator=(Texture&& other);
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	/* Number of levels of a full mip chain down to 1x1 */
+	static int iMipLevelCount(int iWidth, int iHeight);
+
+	/* 2x2 box filter of RGBA8 texels into the next level, max(1, size / 2) in both directions */
+	static void vDownsampleRGBA8(const unsigned char* pucSrc, int iWidth, int iHeight, unsigned char* pucDst);
+
+	void vCreate2D(int iWidth, int iHeight, int iLevels, GLenum eInternalFormat);
+	void vCreate2DArray(int iWidth, int iHeight, int iLayers, int iLevels, GLenum eInternalFormat);
+	void vSetSampling(GLenum eWrap, GLenum eMinFilter, GLenum eMagFilter);
+
+	/* Upload one level (one layer for arrays) from client memory */
+	void vSubImage(int iLevel, int iLayer, int iWidth, int iHeight, GLenum eFormat, const void* pData);
+
+	void vBind(GLenum eUnit) const;
+	void vRelease();
+
+	GLuint uiGetName() const { return m_uiName; }
+	GLenum eGetTarget() const { return m_eTarget; }
+	int iGetWidth() const { return m_iWidth; }
+	int iGetHeight() const { return m_iHeight; }
+	int iGetLayers() const { return m_iLayers; }
+	int iGetLevels() const { return m_iLevels; }
+
+private:
+	GLuint m_uiName;
+	GLenum m_eTarget;
+	int m_iWidth;
+	int m_iHeight;
+	int m_iLayers;
+	int m_iLevels;
+};
@@ -0,0 +1,230 @@
+#include <iostream>
+#include <climits>
+#include <algorithm>
+#include "TextureAtlas.h"
+
+RectanglePacker::RectanglePacker(int iWidth, int iHeight)
+	: m_iWidth(iWidth), m_iHeight(iHeight)
+{
+	SkylineNode node = { 0, 0, iWidth };
+	m_skyline.push_back(node);
+}
+
+/* Returns the lowest y the rectangle can be placed at when its left edge
+   starts at the given skyline node, -1 when it does not fit */
+int RectanglePacker::iFitNode(size_t uiIndex, int iWidth, int iHeight) const
+{
+	int iX = m_skyline[uiIndex].iX;
+	if (iX + iWidth > m_iWidth)
+	{
+		return -1;
+	}
+	int iY = m_skyline[uiIndex].iY;
+	int iWidthLeft = iWidth;
+	while (iWidthLeft > 0)
+	{
+		if (m_skyline[uiIndex].iY > iY)
+		{
+			iY = m_skyline[uiIndex].iY;
+		}
+		if (iY + iHeight > m_iHeight)
+		{
+			return -1;
+		}
+		iWidthLeft -= m_skyline[uiIndex].iWidth;
+		uiIndex++;
+	}
+	return iY;
+}
+
+bool RectanglePacker::bInsert(int iWidth, int iHeight, int& iX, int& iY)
+{
+	int iBestBottom = INT_MAX;
+	int iBestWidth = INT_MAX;
+	size_t uiBestIndex = m_skyline.size();
+
+	/* Bottom-left heuristic: lowest top edge wins, narrower node breaks ties */
+	for (size_t i = 0; i < m_skyline.size(); i++)
+	{
+		int iFitY = iFitNode(i, iWidth, iHeight);
+		if (iFitY < 0)
+		{
+			continue;
+		}
+		if (iFitY + iHeight < iBestBottom || (iFitY + iHeight == iBestBottom && m_skyline[i].iWidth < iBestWidth))
+		{
+			iBestBottom = iFitY + iHeight;
+			iBestWidth = m_skyline[i].iWidth;
+			uiBestIndex = i;
+			iX = m_skyline[i].iX;
+			iY = iFitY;
+		}
+	}
+	if (uiBestIndex == m_skyline.size())
+	{
+		return false;
+	}
+
+	/* Raise the skyline under the new rectangle */
+	SkylineNode node = { iX, iY + iHeight, iWidth };
+	m_skyline.insert(m_skyline.begin() + uiBestIndex, node);
+	for (size_t i = uiBestIndex + 1; i < m_skyline.size();)
+	{
+		int iPrevRight = m_skyline[i - 1].iX + m_skyline[i - 1].iWidth;
+		if (m_skyline[i].iX >= iPrevRight)
+		{
+			break;
+		}
+		int iShrink = iPrevRight - m_skyline[i].iX;
+		m_skyline[i].iX += iShrink;
+		m_skyline[i].iWidth -= iShrink;
+		if (m_skyline[i].iWidth > 0)
+		{
+			break;
+		}
+		m_skyline.erase(m_skyline.begin() + i);
+	}
+
+	/* Merge neighbours of the same height */
+	for (size_t i = 0; i + 1 < m_skyline.size();)
+	{
+		if (m_skyline[i].iY == m_skyline[i + 1].iY)
+		{
+			m_skyline[i].iWidth += m_skyline[i + 1].iWidth;
+			m_skyline.erase(m_skyline.begin() + i + 1);
+		}
+		else
+		{
+			i++;
+		}
+	}
+	return true;
+}
+
+TextureAtlas::TextureAtlas(int iLayerWidth, int iLayerHeight, int iPadding)
+	: m_iLayerWidth(iLayerWidth), m_iLayerHeight(iLayerHeight), m_iPadding(iPadding)
+{
+}
+
+int TextureAtlas::iAddImage(const unsigned char* pucPixels, int iWidth, int iHeight, int iChannels)
+{
+	int iPaddedWidth = iWidth + 2 * m_iPadding;
+	int iPaddedHeight = iHeight + 2 * m_iPadding;
+	if (iPaddedWidth > m_iLayerWidth || iPaddedHeight > m_iLayerHeight || iChannels < 1 || iChannels > 4)
+	{
+		std::cout << "The image " << iWidth << "x" << iHeight << " can not be placed in the atlas" << std::endl;
+		return -1;
+	}
+
+	/* Try the existing layers first, open a new one when all of them are full */
+	int iX = 0;
+	int iY = 0;
+	size_t uiLayer = 0;
+	while (uiLayer < m_packers.size() && !m_packers[uiLayer].bInsert(iPaddedWidth, iPaddedHeight, iX, iY))
+	{
+		uiLayer++;
+	}
+	if (uiLayer == m_packers.size())
+	{
+		m_packers.push_back(RectanglePacker(m_iLayerWidth, m_iLayerHeight));
+		m_layers.push_back(std::vector<unsigned char>((size_t)m_iLayerWidth * m_iLayerHeight * 4, 0));
+		m_packers.back().bInsert(iPaddedWidth, iPaddedHeight, iX, iY);
+	}
+	vCopyPadded(m_layers[uiLayer], iX, iY, pucPixels, iWidth, iHeight, iChannels);
+
+	AtlasRegion region;
+	region.iLayer = (int)uiLayer;
+	region.uvRect = glm::vec4(
+		(float)(iX + m_iPadding) / m_iLayerWidth,
+		(float)(iY + m_iPadding) / m_iLayerHeight,
+		(float)iWidth / m_iLayerWidth,
+		(float)iHeight / m_iLayerHeight);
+	m_regions.push_back(region);
+	return (int)m_regions.size() - 1;
+}
+
+/* Copy the image as RGBA and extrude its edge texels into the padding so
+   bilinear filtering never picks up a neighbouring image */
+void TextureAtlas::vCopyPadded(std::vector<unsigned char>& layer, int iX, int iY, const unsigned char* pucPixels, int iWidth, int iHeight, int iChannels) const
+{
+	for (int y = -m_iPadding; y < iHeight + m_iPadding; y++)
+	{
+		int iSrcY = glm::clamp(y, 0, iHeight - 1);
+		for (int x = -m_iPadding; x < iWidth + m_iPadding; x++)
+		{
+			int iSrcX = glm::clamp(x, 0, iWidth - 1);
+			const unsigned char* pucSrc = pucPixels + ((size_t)iSrcY * iWidth + iSrcX) * iChannels;
+			unsigned char* pucDst = &layer[((size_t)(iY + m_iPadding + y) * m_iLayerWidth + (iX + m_iPadding + x)) * 4];
+			if (iChannels < 3)
+			{
+				pucDst[0] = pucDst[1] = pucDst[2] = pucSrc[0];
+				pucDst[3] = (iChannels == 2) ? pucSrc[1] : 255;
+			}
+			else
+			{
+				pucDst[0] = pucSrc[0];
+				pucDst[1] = pucSrc[1];
+				pucDst[2] = pucSrc[2];
+				pucDst[3] = (iChannels == 4) ? pucSrc[3] : 255;
+			}
+		}
+	}
+}
+
+/* A level is only bleed free while the padding still covers at least one
+   texel of it, so the chain stops before the images start to touch */
+int TextureAtlas::iSafeMipLevels() const
+{
+	int iLevels = 1;
+	for (int iPadding = m_iPadding; iPadding > 1; iPadding >>= 1)
+	{
+		iLevels++;
+	}
+	int iFullChain = Texture::iMipLevelCount(m_iLayerWidth, m_iLayerHeight);
+	return (iLevels < iFullChain) ? iLevels : iFullChain;
+}
+
+int TextureAtlas::iBuild(TextureManager& manager)
+{
+	int iLayers = m_layers.empty() ? 1 : (int)m_layers.size();
+	size_t uiLayerBytes = (size_t)m_iLayerWidth * m_iLayerHeight * 4;
+
+	TextureManager::Asset asset;
+	asset.eTarget = GL_TEXTURE_2D_ARRAY;
+	asset.eInternalFormat = GL_RGBA8;
+	asset.eFormat = GL_RGBA;
+	asset.iWidth = m_iLayerWidth;
+	asset.iHeight = m_iLayerHeight;
+	asset.iLayers = iLayers;
+	asset.iBytesPerTexel = 4;
+	/* UVs never leave their own region, so wrapping is replaced by clamping */
+	asset.eWrap = GL_CLAMP_TO_EDGE;
+	asset.eMinFilter = GL_LINEAR_MIPMAP_LINEAR;
+	asset.eMagFilter = GL_LINEAR;
+	asset.levels.resize(iSafeMipLevels());
+
+	asset.levels[0].resize(uiLayerBytes * iLayers, 0);
+	for (size_t i = 0; i < m_layers.size(); i++)
+	{
+		std::copy(m_layers[i].begin(), m_layers[i].end(), asset.levels[0].begin() + i * uiLayerBytes);
+	}
+
+	/* The mips are filtered on the CPU once, the asset cache needs them to reload evicted levels */
+	for (size_t iLevel = 1; iLevel < asset.levels.size(); iLevel++)
+	{
+		int iWidth = std::max(1, m_iLayerWidth >> (iLevel - 1));
+		int iHeight = std::max(1, m_iLayerHeight >> (iLevel - 1));
+		size_t uiSrcLayerBytes = (size_t)iWidth * iHeight * 4;
+		size_t uiDstLayerBytes = (size_t)std::max(1, iWidth / 2) * std::max(1, iHeight / 2) * 4;
+		asset.levels[iLevel].resize(uiDstLayerBytes * iLayers);
+		for (int iLayer = 0; iLayer < iLayers; iLayer++)
+		{
+			Texture::vDownsampleRGBA8(asset.levels[iLevel - 1].data() + iLayer * uiSrcLayerBytes, iWidth, iHeight, asset.levels[iLevel].data() + iLayer * uiDstLayerBytes);
+		}
+	}
+	std::cout << "Texture atlas: " << m_regions.size() << " images packed into " << iLayers << " layers with " << asset.levels.size() << " mip levels" << std::endl;
+
+	m_packers.clear();
+	m_layers.clear();
+	return manager.iAdd(std::move(asset));
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <../../glad/include/glad/glad.h>
+#include <../../glm/glm.hpp>
+#include "TextureManager.h"
+
+/* Location of one packed image: the array layer it lives in and the UV
+   rectangle (xy = offset, zw = scale) that maps the original [0,1] UVs
+   of the image into that layer */
+struct AtlasRegion
+{
+	int iLayer;
+	glm::vec4 uvRect;
+};
+
+/* Skyline bottom-left rectangle packer filling a single atlas layer */
+class RectanglePacker
+{
+public:
+	RectanglePacker(int iWidth, int iHeight);
+
+	/* Find a place for a iWidth x iHeight rectangle, false when the layer is full */
+	bool bInsert(int iWidth, int iHeight, int& iX, int& iY);
+
+private:
+	struct SkylineNode
+	{
+		int iX;
+		int iY;
+		int iWidth;
+	};
+
+	int iFitNode(size_t uiIndex, int iWidth, int iHeight) const;
+
+	int m_iWidth;
+	int m_iHeight;
+	std::vector<SkylineNode> m_skyline;
+};
+
+/* Packs many small images into the layers of one GL_TEXTURE_2D_ARRAY so a
+   whole scene can be drawn with a single texture bind */
+class TextureAtlas
+{
+public:
+	TextureAtlas(int iLayerWidth = 1024, int iLayerHeight = 1024, int iPadding = 8);
+
+	/* Copy the image into the atlas staging memory, returns the region index or -1 */
+	int iAddImage(const unsigned char* pucPixels, int iWidth, int iHeight, int iChannels);
+
+	/* Build the mip chain of the staged layers and register it with the manager, returns the texture handle */
+	int iBuild(TextureManager& manager);
+
+	const AtlasRegion& getRegion(int iImage) const { return m_regions[iImage]; }
+
+private:
+	int iSafeMipLevels() const;
+	void vCopyPadded(std::vector<unsigned char>& layer, int iX, int iY, const unsigned char* pucPixels, int iWidth, int iHeight, int iChannels) const;
+
+	int m_iLayerWidth;
+	int m_iLayerHeight;
+	int m_iPadding;
+	std::vector<RectanglePacker> m_packers;
+	std::vector<std::vector<unsigned char>> m_layers;
+	std::vector<AtlasRegion> m_regions;
+};
@@ -0,0 +1,143 @@
+#include "TextureBudget.h"
+
+TextureBudget::TextureBudget(size_t uiBudgetBytes)
+	: m_uiBudget(uiBudgetBytes), m_uiResident(0), m_uiFrame(0)
+{
+}
+
+size_t TextureBudget::uiLevelBytes(int iWidth, int iHeight, int iLayers, int iBytesPerTexel, int iLevel)
+{
+	size_t uiWidth = (iWidth >> iLevel) > 0 ? (size_t)(iWidth >> iLevel) : 1;
+	size_t uiHeight = (iHeight >> iLevel) > 0 ? (size_t)(iHeight >> iLevel) : 1;
+	return uiWidth * uiHeight * iLayers * iBytesPerTexel;
+}
+
+int TextureBudget::iRegister(int iWidth, int iHeight, int iLayers, int iLevels, int iBytesPerTexel, int iResidentBase)
+{
+	Entry entry;
+	entry.iWidth = iWidth;
+	entry.iHeight = iHeight;
+	entry.iLayers = iLayers;
+	entry.iLevels = iLevels;
+	entry.iBytesPerTexel = iBytesPerTexel;
+	entry.iResidentBase = iResidentBase;
+	entry.iOriginalBase = iResidentBase;
+	entry.uiLastUsed = m_uiFrame;
+	entry.bPinned = false;
+	m_textures.push_back(entry);
+	m_uiResident += uiBytesBetween(entry, iResidentBase, iLevels);
+	return (int)m_textures.size() - 1;
+}
+
+size_t TextureBudget::uiBytesBetween(const Entry& entry, int iFirstLevel, int iEndLevel) const
+{
+	size_t uiBytes = 0;
+	for (int iLevel = iFirstLevel; iLevel < iEndLevel; iLevel++)
+	{
+		uiBytes += uiLevelBytes(entry.iWidth, entry.iHeight, entry.iLayers, entry.iBytesPerTexel, iLevel);
+	}
+	return uiBytes;
+}
+
+size_t TextureBudget::uiGetTextureBytes(int iHandle) const
+{
+	const Entry& entry = m_textures[iHandle];
+	return uiBytesBetween(entry, entry.iResidentBase, entry.iLevels);
+}
+
+/* Bytes that could be freed without touching anything bound this frame or pinned */
+size_t TextureBudget::uiEvictableBytes() const
+{
+	size_t uiBytes = 0;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		if (m_textures[i].uiLastUsed < m_uiFrame && !m_textures[i].bPinned)
+		{
+			uiBytes += uiBytesBetween(m_textures[i], m_textures[i].iResidentBase, m_textures[i].iLevels);
+		}
+	}
+	return uiBytes;
+}
+
+void TextureBudget::vMarkChanged(int iHandle)
+{
+	for (size_t i = 0; i < m_changed.size(); i++)
+	{
+		if (m_changed[i] == iHandle)
+		{
+			return;
+		}
+	}
+	m_changed.push_back(iHandle);
+}
+
+/* Drop top mips of the least recently bound textures until uiNeeded more bytes fit */
+bool TextureBudget::bMakeRoom(size_t uiNeeded)
+{
+	while (m_uiResident + uiNeeded > m_uiBudget)
+	{
+		int iVictim = -1;
+		for (size_t i = 0; i < m_textures.size(); i++)
+		{
+			const Entry& entry = m_textures[i];
+			if (entry.uiLastUsed < m_uiFrame && !entry.bPinned && entry.iResidentBase < entry.iLevels && (iVictim < 0 || entry.uiLastUsed < m_textures[iVictim].uiLastUsed))
+			{
+				iVictim = (int)i;
+			}
+		}
+		if (iVictim < 0)
+		{
+			return false;
+		}
+		Entry& victim = m_textures[iVictim];
+		m_uiResident -= uiLevelBytes(victim.iWidth, victim.iHeight, victim.iLayers, victim.iBytesPerTexel, victim.iResidentBase);
+		victim.iResidentBase++;
+		vMarkChanged(iVictim);
+	}
+	return true;
+}
+
+void TextureBudget::vBalance(std::vector<Change>& changes)
+{
+	changes.clear();
+
+	/* Bring textures used this frame back to the finest level the budget allows */
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		Entry& entry = m_textures[i];
+		if (entry.uiLastUsed != m_uiFrame || entry.iResidentBase == 0)
+		{
+			continue;
+		}
+		size_t uiAvailable = ((m_uiBudget > m_uiResident) ? m_uiBudget - m_uiResident : 0) + uiEvictableBytes();
+		int iTarget = entry.iResidentBase;
+		while (iTarget > 0 && uiBytesBetween(entry, iTarget - 1, entry.iResidentBase) <= uiAvailable)
+		{
+			iTarget--;
+		}
+		if (iTarget == entry.iResidentBase)
+		{
+			continue;
+		}
+		size_t uiNeeded = uiBytesBetween(entry, iTarget, entry.iResidentBase);
+		bMakeRoom(uiNeeded);
+		m_uiResident += uiNeeded;
+		entry.iResidentBase = iTarget;
+		vMarkChanged((int)i);
+	}
+
+	/* The budget may also have shrunk since the last frame */
+	bMakeRoom(0);
+
+	for (size_t i = 0; i < m_changed.size(); i++)
+	{
+		Entry& entry = m_textures[m_changed[i]];
+		if (entry.iResidentBase != entry.iOriginalBase)
+		{
+			Change change = { m_changed[i], entry.iOriginalBase, entry.iResidentBase };
+			changes.push_back(change);
+			entry.iOriginalBase = entry.iResidentBase;
+		}
+	}
+	m_changed.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Memory accounting and eviction policy for textures, free of any GL call.
+   Every texture is tracked per mip level; iResidentBase is the first level
+   that is in memory, so dropping the top mip means raising it by one and a
+   value equal to the level count means the texture is fully evicted.
+   Textures bound in the current frame are promoted back towards full
+   resolution, the least recently bound ones give up their top mips first
+   whenever the budget would be exceeded. Pinned textures are never
+   evicted */
+class TextureBudget
+{
+public:
+	struct Change
+	{
+		int iHandle;
+		int iOldBase;
+		int iNewBase;
+	};
+
+	explicit TextureBudget(size_t uiBudgetBytes);
+
+	static size_t uiLevelBytes(int iWidth, int iHeight, int iLayers, int iBytesPerTexel, int iLevel);
+
+	int iRegister(int iWidth, int iHeight, int iLayers, int iLevels, int iBytesPerTexel, int iResidentBase);
+	void vSetBudget(size_t uiBudgetBytes) { m_uiBudget = uiBudgetBytes; }
+
+	/* Advance the frame counter, touches from now on count for the new frame */
+	void vBeginFrame() { m_uiFrame++; }
+
+	/* The texture was bound in the current frame */
+	void vTouch(int iHandle) { m_textures[iHandle].uiLastUsed = m_uiFrame; }
+
+	/* A pinned texture keeps all its resident levels, whenever it was last bound */
+	void vSetPinned(int iHandle, bool bPinned) { m_textures[iHandle].bPinned = bPinned; }
+
+	/* Decide promotions and evictions for this frame and apply them to the accounting */
+	void vBalance(std::vector<Change>& changes);
+
+	int iGetResidentBase(int iHandle) const { return m_textures[iHandle].iResidentBase; }
+	size_t uiGetResidentBytes() const { return m_uiResident; }
+	size_t uiGetBudget() const { return m_uiBudget; }
+	size_t uiGetTextureBytes(int iHandle) const;
+
+private:
+	struct Entry
+	{
+		int iWidth;
+		int iHeight;
+		int iLayers;
+		int iLevels;
+		int iBytesPerTexel;
+		int iResidentBase;
+		int iOriginalBase;
+		uint64_t uiLastUsed;
+		bool bPinned;
+	};
+
+	size_t uiBytesBetween(const Entry& entry, int iFirstLevel, int iEndLevel) const;
+	size_t uiEvictableBytes() const;
+	bool bMakeRoom(size_t uiNeeded);
+	void vMarkChanged(int iHandle);
+
+	size_t m_uiBudget;
+	size_t m_uiResident;
+	uint64_t m_uiFrame;
+	std::vector<Entry> m_textures;
+	std::vector<int> m_changed;
+};
@@ -0,0 +1,137 @@
+#include "TextureManager.h"
+
+TextureManager::TextureManager(size_t uiBudgetBytes)
+	: m_budget(uiBudgetBytes)
+{
+}
+
+int TextureManager::iAdd(Asset&& asset)
+{
+	/* Nothing is resident yet, the registration counts as a use so the first update loads it */
+	int iLevels = (int)asset.levels.size();
+	int iHandle = m_budget.iRegister(asset.iWidth, asset.iHeight, asset.iLayers, iLevels, asset.iBytesPerTexel, iLevels);
+
+	Entry entry;
+	entry.asset = std::move(asset);
+	entry.iTextureBase = iLevels;
+	entry.iWantedBase = iLevels;
+	entry.iIncomingBase = iLevels;
+	entry.uiIncomingTicket = 0;
+	entry.bIncoming = false;
+	m_textures.push_back(std::move(entry));
+	return iHandle;
+}
+
+void TextureManager::vBind(int iHandle, GLenum eUnit, GLStateCache& state)
+{
+	m_budget.vTouch(iHandle);
+	const Texture& texture = m_textures[iHandle].texture;
+	state.vBindTexture(eUnit, texture.eGetTarget(), texture.uiGetName());
+}
+
+bool TextureManager::bUpdate(TextureStreamer& streamer)
+{
+	bool bChanged = false;
+
+	/* Swap in the reloaded textures whose uploads went out */
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		Entry& entry = m_textures[i];
+		if (entry.bIncoming && streamer.bIsComplete(entry.uiIncomingTicket))
+		{
+			entry.texture = std::move(entry.incoming);
+			entry.iTextureBase = entry.iIncomingBase;
+			entry.bIncoming = false;
+			bChanged = true;
+		}
+	}
+
+	m_budget.vBalance(m_changes);
+	for (size_t i = 0; i < m_changes.size(); i++)
+	{
+		m_textures[m_changes[i].iHandle].iWantedBase = m_changes[i].iNewBase;
+	}
+
+	/* A texture with a reload still in flight picks up its new base once that finishes */
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		Entry& entry = m_textures[i];
+		if (!entry.bIncoming && entry.iWantedBase != entry.iTextureBase)
+		{
+			vApply(entry, streamer);
+			bChanged = true;
+		}
+	}
+	m_budget.vBeginFrame();
+	return bChanged;
+}
+
+void TextureManager::vApply(Entry& entry, TextureStreamer& streamer)
+{
+	const Asset& asset = entry.asset;
+	int iLevels = (int)asset.levels.size();
+	int iOldBase = entry.iTextureBase;
+	int iNewBase = entry.iWantedBase;
+	if (iNewBase >= iLevels)
+	{
+		entry.texture.vRelease();
+		entry.iTextureBase = iLevels;
+		return;
+	}
+
+	int iWidth = (asset.iWidth >> iNewBase) > 0 ? (asset.iWidth >> iNewBase) : 1;
+	int iHeight = (asset.iHeight >> iNewBase) > 0 ? (asset.iHeight >> iNewBase) : 1;
+	Texture next;
+	if (asset.eTarget == GL_TEXTURE_2D_ARRAY)
+	{
+		next.vCreate2DArray(iWidth, iHeight, asset.iLayers, iLevels - iNewBase, asset.eInternalFormat);
+	}
+	else
+	{
+		next.vCreate2D(iWidth, iHeight, iLevels - iNewBase, asset.eInternalFormat);
+	}
+	next.vSetSampling(asset.eWrap, asset.eMinFilter, asset.eMagFilter);
+
+	/* Levels both textures have are copied on the GPU */
+	int iFirstShared = (iOldBase > iNewBase) ? iOldBase : iNewBase;
+	for (int iLevel = iFirstShared; iLevel < iLevels; iLevel++)
+	{
+		int iLevelWidth = (asset.iWidth >> iLevel) > 0 ? (asset.iWidth >> iLevel) : 1;
+		int iLevelHeight = (asset.iHeight >> iLevel) > 0 ? (asset.iHeight >> iLevel) : 1;
+		glCopyImageSubData(entry.texture.uiGetName(), asset.eTarget, iLevel - iOldBase, 0, 0, 0,
+			next.uiGetName(), asset.eTarget, iLevel - iNewBase, 0, 0, 0, iLevelWidth, iLevelHeight, asset.iLayers);
+	}
+
+	if (iNewBase >= iOldBase)
+	{
+		entry.texture = std::move(next);
+		entry.iTextureBase = iNewBase;
+		return;
+	}
+
+	/* The missing top levels come from the asset cache through the streamer */
+	for (int iLevel = iNewBase; iLevel < iOldBase && iLevel < iLevels; iLevel++)
+	{
+		int iLevelWidth = (asset.iWidth >> iLevel) > 0 ? (asset.iWidth >> iLevel) : 1;
+		int iLevelHeight = (asset.iHeight >> iLevel) > 0 ? (asset.iHeight >> iLevel) : 1;
+		size_t uiLayerBytes = (size_t)iLevelWidth * iLevelHeight * asset.iBytesPerTexel;
+		for (int iLayer = 0; iLayer < asset.iLayers; iLayer++)
+		{
+			const unsigned char* pucLayer = asset.levels[iLevel].data() + iLayer * uiLayerBytes;
+			std::vector<unsigned char> pixels(pucLayer, pucLayer + uiLayerBytes);
+			entry.uiIncomingTicket = streamer.uiQueue(next.uiGetName(), asset.eTarget, iLevel - iNewBase, iLayer, 0, 0, iLevelWidth, iLevelHeight, asset.eFormat, std::move(pixels), false);
+		}
+	}
+	entry.incoming = std::move(next);
+	entry.iIncomingBase = iNewBase;
+	entry.bIncoming = true;
+}
+
+void TextureManager::vRelease()
+{
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		m_textures[i].texture.vRelease();
+		m_textures[i].incoming.vRelease();
+	}
+}
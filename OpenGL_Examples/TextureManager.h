@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <../../glad/include/glad/glad.h>
+#include "GLState.h"
+#include "Texture.h"
+#include "TextureBudget.h"
+#include "TextureStreamer.h"
+
+/* Keeps the textures of the scene within a video memory budget. The
+   decoded pixels of every level stay in the asset cache, so levels the
+   TextureBudget policy evicts can be reloaded once the texture is bound
+   again. Dropping levels copies the remaining ones on the GPU into a
+   smaller immutable texture, reloading streams the missing levels in and
+   swaps the textures when the upload has been issued */
+class TextureManager
+{
+public:
+	/* Decoded pixels of all levels, each level holds all its layers back to back */
+	struct Asset
+	{
+		GLenum eTarget;
+		GLenum eInternalFormat;
+		GLenum eFormat;
+		int iWidth;
+		int iHeight;
+		int iLayers;
+		int iBytesPerTexel;
+		GLenum eWrap;
+		GLenum eMinFilter;
+		GLenum eMagFilter;
+		std::vector<std::vector<unsigned char>> levels;
+	};
+
+	explicit TextureManager(size_t uiBudgetBytes);
+
+	/* Register a texture, it is loaded by the next bUpdate */
+	int iAdd(Asset&& asset);
+
+	/* Bind the resident levels of the texture and count it as used in this frame */
+	void vBind(int iHandle, GLenum eUnit, GLStateCache& state);
+
+	/* Apply the evictions and reloads the budget asks for, once per frame.
+	   Returns whether a texture was created, bound or deleted for that */
+	bool bUpdate(TextureStreamer& streamer);
+
+	void vRelease();
+
+	TextureBudget& getBudget() { return m_budget; }
+
+private:
+	struct Entry
+	{
+		Asset asset;
+		Texture texture;
+		int iTextureBase;
+		int iWantedBase;
+		Texture incoming;
+		int iIncomingBase;
+		uint64_t uiIncomingTicket;
+		bool bIncoming;
+	};
+
+	void vApply(Entry& entry, TextureStreamer& streamer);
+
+	TextureBudget m_budget;
+	std::vector<Entry> m_textures;
+	std::vector<TextureBudget::Change> m_changes;
+};
@@ -0,0 +1,170 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include "TextureStreamer.h"
+
+TextureStreamer::TextureStreamer(size_t uiSlotSize, int iSlotCount, size_t uiFrameBudget)
+	: m_uiSlotSize(uiSlotSize), m_uiFrameBudget(uiFrameBudget), m_uiBuffer(0), m_pucMapped(NULL), m_slots(iSlotCount), m_uiNextSlot(0), m_uiQueued(0), m_uiCompleted(0)
+{
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		m_slots[i].uiOffset = i * uiSlotSize;
+		m_slots[i].sync = 0;
+	}
+}
+
+bool TextureStreamer::bInit()
+{
+	GLsizeiptr iSize = (GLsizeiptr)(m_uiSlotSize * m_slots.size());
+	GLbitfield uiFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &m_uiBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uiBuffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, iSize, NULL, uiFlags);
+	m_pucMapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, iSize, uiFlags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (m_pucMapped == NULL)
+	{
+		std::cout << "ERROR::STREAMER::The pixel unpack buffer can not be mapped" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void TextureStreamer::vRelease()
+{
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		if (m_slots[i].sync)
+		{
+			glDeleteSync(m_slots[i].sync);
+			m_slots[i].sync = 0;
+		}
+	}
+	if (m_uiBuffer)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uiBuffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &m_uiBuffer);
+		m_uiBuffer = 0;
+	}
+	m_pucMapped = NULL;
+	m_queue.clear();
+}
+
+int TextureStreamer::iBytesPerPixel(GLenum eFormat)
+{
+	switch (eFormat)
+	{
+	case GL_RED:
+		return 1;
+	case GL_RG:
+		return 2;
+	case GL_RGB:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+uint64_t TextureStreamer::uiQueue(GLuint uiTexture, GLenum eTarget, GLint iLevel, GLint iLayer, int iX, int iY, int iWidth, int iHeight, GLenum eFormat, std::vector<unsigned char>&& pixels, bool bGenerateMipmap)
+{
+	Upload upload;
+	upload.uiTexture = uiTexture;
+	upload.eTarget = eTarget;
+	upload.iLevel = iLevel;
+	upload.iLayer = iLayer;
+	upload.iX = iX;
+	upload.iY = iY;
+	upload.iWidth = iWidth;
+	upload.iHeight = iHeight;
+	upload.eFormat = eFormat;
+	upload.bGenerateMipmap = bGenerateMipmap;
+	upload.iRowsDone = 0;
+	upload.uiTicket = ++m_uiQueued;
+	upload.pixels = std::move(pixels);
+	m_queue.push_back(std::move(upload));
+	return m_uiQueued;
+}
+
+bool TextureStreamer::bUpdate()
+{
+	if (m_queue.empty() || m_pucMapped == NULL)
+	{
+		return false;
+	}
+
+	size_t uiBudgetLeft = m_uiFrameBudget;
+	bool bBound = false;
+	while (!m_queue.empty() && uiBudgetLeft > 0)
+	{
+		/* The GPU still reads the oldest slot, try again next frame */
+		Slot& slot = m_slots[m_uiNextSlot];
+		if (slot.sync)
+		{
+			if (glClientWaitSync(slot.sync, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				break;
+			}
+			glDeleteSync(slot.sync);
+			slot.sync = 0;
+		}
+
+		Upload& upload = m_queue.front();
+		size_t uiRowBytes = (size_t)upload.iWidth * iBytesPerPixel(upload.eFormat);
+		if (uiRowBytes > m_uiSlotSize)
+		{
+			std::cout << "ERROR::STREAMER::A texture row does not fit into one slot" << std::endl;
+			m_uiCompleted = upload.uiTicket;
+			m_queue.pop_front();
+			continue;
+		}
+		/* Always move by at least one row per frame, even with a tiny budget */
+		size_t uiLimit = std::min(m_uiSlotSize, std::max(uiBudgetLeft, (uiBudgetLeft == m_uiFrameBudget) ? uiRowBytes : 0));
+		int iRows = std::min((int)(uiLimit / uiRowBytes), upload.iHeight - upload.iRowsDone);
+		if (iRows == 0)
+		{
+			break;
+		}
+
+		if (!bBound)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uiBuffer);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			bBound = true;
+		}
+		size_t uiBytes = (size_t)iRows * uiRowBytes;
+		memcpy(m_pucMapped + slot.uiOffset, upload.pixels.data() + (size_t)upload.iRowsDone * uiRowBytes, uiBytes);
+
+		glBindTexture(upload.eTarget, upload.uiTexture);
+		if (upload.eTarget == GL_TEXTURE_2D_ARRAY)
+		{
+			glTexSubImage3D(upload.eTarget, upload.iLevel, upload.iX, upload.iY + upload.iRowsDone, upload.iLayer, upload.iWidth, iRows, 1, upload.eFormat, GL_UNSIGNED_BYTE, (void*)slot.uiOffset);
+		}
+		else
+		{
+			glTexSubImage2D(upload.eTarget, upload.iLevel, upload.iX, upload.iY + upload.iRowsDone, upload.iWidth, iRows, upload.eFormat, GL_UNSIGNED_BYTE, (void*)slot.uiOffset);
+		}
+		slot.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_uiNextSlot = (m_uiNextSlot + 1) % m_slots.size();
+
+		uiBudgetLeft -= std::min(uiBudgetLeft, uiBytes);
+		upload.iRowsDone += iRows;
+		if (upload.iRowsDone == upload.iHeight)
+		{
+			if (upload.bGenerateMipmap)
+			{
+				glGenerateMipmap(upload.eTarget);
+			}
+			m_uiCompleted = upload.uiTicket;
+			m_queue.pop_front();
+		}
+	}
+	if (bBound)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	return bBound;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <../../glad/include/glad/glad.h>
+
+/* Streams decoded images into textures through a ring of persistently
+   mapped pixel unpack buffer slots. Each slot is guarded by a fence, and
+   bUpdate never copies more than the frame budget, so a large texture is
+   spread over several frames instead of stalling one of them */
+class TextureStreamer
+{
+public:
+	TextureStreamer(size_t uiSlotSize = 4 * 1024 * 1024, int iSlotCount = 3, size_t uiFrameBudget = 4 * 1024 * 1024);
+
+	bool bInit();
+	void vRelease();
+
+	/* Queue the pixels of one region of a level (and layer for array textures) for upload,
+	   the queue takes ownership. Returns a ticket to check for completion */
+	uint64_t uiQueue(GLuint uiTexture, GLenum eTarget, GLint iLevel, GLint iLayer, int iX, int iY, int iWidth, int iHeight, GLenum eFormat, std::vector<unsigned char>&& pixels, bool bGenerateMipmap);
+
+	/* Upload as many rows as the frame budget and the free slots allow.
+	   Returns whether a texture was bound for that */
+	bool bUpdate();
+
+	bool bIdle() const { return m_queue.empty(); }
+
+	/* Uploads finish in queue order, so one counter answers for all tickets */
+	bool bIsComplete(uint64_t uiTicket) const { return uiTicket <= m_uiCompleted; }
+
+private:
+	struct Upload
+	{
+		GLuint uiTexture;
+		GLenum eTarget;
+		GLint iLevel;
+		GLint iLayer;
+		int iX;
+		int iY;
+		int iWidth;
+		int iHeight;
+		GLenum eFormat;
+		bool bGenerateMipmap;
+		int iRowsDone;
+		uint64_t uiTicket;
+		std::vector<unsigned char> pixels;
+	};
+
+	struct Slot
+	{
+		size_t uiOffset;
+		GLsync sync;
+	};
+
+	static int iBytesPerPixel(GLenum eFormat);
+
+	size_t m_uiSlotSize;
+	size_t m_uiFrameBudget;
+	GLuint m_uiBuffer;
+	unsigned char* m_pucMapped;
+	std::vector<Slot> m_slots;
+	size_t m_uiNextSlot;
+	std::deque<Upload> m_queue;
+	uint64_t m_uiQueued;
+	uint64_t m_uiCompleted;
+};
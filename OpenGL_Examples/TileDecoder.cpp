@@ -0,0 +1,135 @@
+#include <algorithm>
+#include "PageCache.h"
+#include "Texture.h"
+#include "TileDecoder.h"
+
+ImageTileSource::ImageTileSource(const unsigned char* pucPixels, int iWidth, int iHeight, int iChannels)
+{
+	/* Level 0 is converted to RGBA once, every coarser level is a 2x2 box filter of the previous one */
+	Level base;
+	base.iWidth = iWidth;
+	base.iHeight = iHeight;
+	base.pixels.resize((size_t)iWidth * iHeight * 4);
+	for (size_t i = 0; i < (size_t)iWidth * iHeight; i++)
+	{
+		const unsigned char* pucSrc = pucPixels + i * iChannels;
+		unsigned char* pucDst = &base.pixels[i * 4];
+		pucDst[0] = pucSrc[0];
+		pucDst[1] = (iChannels >= 3) ? pucSrc[1] : pucSrc[0];
+		pucDst[2] = (iChannels >= 3) ? pucSrc[2] : pucSrc[0];
+		pucDst[3] = (iChannels == 4) ? pucSrc[3] : ((iChannels == 2) ? pucSrc[1] : 255);
+	}
+	m_levels.push_back(std::move(base));
+
+	while (m_levels.back().iWidth > 1 || m_levels.back().iHeight > 1)
+	{
+		const Level& fine = m_levels.back();
+		Level coarse;
+		coarse.iWidth = std::max(1, fine.iWidth / 2);
+		coarse.iHeight = std::max(1, fine.iHeight / 2);
+		coarse.pixels.resize((size_t)coarse.iWidth * coarse.iHeight * 4);
+		Texture::vDownsampleRGBA8(fine.pixels.data(), fine.iWidth, fine.iHeight, coarse.pixels.data());
+		m_levels.push_back(std::move(coarse));
+	}
+}
+
+bool ImageTileSource::bReadTile(int iMip, int iX, int iY, int iTileSize, int iBorder, unsigned char* pucOut)
+{
+	const Level& level = m_levels[std::min(iMip, (int)m_levels.size() - 1)];
+	int iSize = iTileSize + 2 * iBorder;
+	int iStartX = iX * iTileSize - iBorder;
+	int iStartY = iY * iTileSize - iBorder;
+
+	/* Texels outside of the image repeat its edge, the same as clamp to edge sampling would */
+	for (int y = 0; y < iSize; y++)
+	{
+		int iSrcY = std::min(std::max(iStartY + y, 0), level.iHeight - 1);
+		for (int x = 0; x < iSize; x++)
+		{
+			int iSrcX = std::min(std::max(iStartX + x, 0), level.iWidth - 1);
+			const unsigned char* pucSrc = &level.pixels[((size_t)iSrcY * level.iWidth + iSrcX) * 4];
+			std::copy(pucSrc, pucSrc + 4, pucOut + ((size_t)y * iSize + x) * 4);
+		}
+	}
+	return true;
+}
+
+TileDecoder::TileDecoder(TileSource& source, int iTileSize, int iBorder)
+	: m_source(source), m_iTileSize(iTileSize), m_iBorder(iBorder), m_bRunning(false)
+{
+}
+
+TileDecoder::~TileDecoder()
+{
+	vStop();
+}
+
+void TileDecoder::vStart()
+{
+	if (!m_bRunning)
+	{
+		m_bRunning = true;
+		m_worker = std::thread(&TileDecoder::vRun, this);
+	}
+}
+
+void TileDecoder::vStop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bRunning = false;
+	}
+	m_wakeUp.notify_all();
+	if (m_worker.joinable())
+	{
+		m_worker.join();
+	}
+}
+
+void TileDecoder::vRequest(uint32_t uiKey)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(uiKey);
+	}
+	m_wakeUp.notify_one();
+}
+
+bool TileDecoder::bPopDecoded(Tile& tile)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_decoded.empty())
+	{
+		return false;
+	}
+	tile = std::move(m_decoded.front());
+	m_decoded.pop_front();
+	return true;
+}
+
+void TileDecoder::vRun()
+{
+	size_t uiTileBytes = (size_t)(m_iTileSize + 2 * m_iBorder) * (m_iTileSize + 2 * m_iBorder) * 4;
+	for (;;)
+	{
+		uint32_t uiKey;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [this]() { return !m_bRunning || !m_requests.empty(); });
+			if (!m_bRunning)
+			{
+				return;
+			}
+			uiKey = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		Tile tile;
+		tile.uiKey = uiKey;
+		tile.pixels.resize(uiTileBytes);
+		tile.bValid = m_source.bReadTile(PageCache::iKeyMip(uiKey), PageCache::iKeyX(uiKey), PageCache::iKeyY(uiKey), m_iTileSize, m_iBorder, tile.pixels.data());
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_decoded.push_back(std::move(tile));
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Source of virtual texture tiles. A tile of level iMip covers the texels
+   [x * iTileSize - iBorder, (x + 1) * iTileSize + iBorder) of that level in
+   both directions and is written as RGBA8 */
+class TileSource
+{
+public:
+	virtual ~TileSource() {}
+	virtual int iGetWidth() const = 0;
+	virtual int iGetHeight() const = 0;
+	virtual bool bReadTile(int iMip, int iX, int iY, int iTileSize, int iBorder, unsigned char* pucOut) = 0;
+};
+
+/* Tile source over a decoded image, the mip chain is box filtered on the CPU */
+class ImageTileSource : public TileSource
+{
+public:
+	ImageTileSource(const unsigned char* pucPixels, int iWidth, int iHeight, int iChannels);
+
+	int iGetWidth() const { return m_levels[0].iWidth; }
+	int iGetHeight() const { return m_levels[0].iHeight; }
+	bool bReadTile(int iMip, int iX, int iY, int iTileSize, int iBorder, unsigned char* pucOut);
+
+private:
+	struct Level
+	{
+		int iWidth;
+		int iHeight;
+		std::vector<unsigned char> pixels;
+	};
+
+	std::vector<Level> m_levels;
+};
+
+/* Decodes requested tiles on a worker thread so the render loop only ever
+   copies finished tiles into the physical cache */
+class TileDecoder
+{
+public:
+	struct Tile
+	{
+		uint32_t uiKey;
+		bool bValid;
+		std::vector<unsigned char> pixels;
+	};
+
+	TileDecoder(TileSource& source, int iTileSize, int iBorder);
+	~TileDecoder();
+
+	void vStart();
+	void vStop();
+
+	/* Page keys are decoded as PageCache::uiPageKey packs them */
+	void vRequest(uint32_t uiKey);
+	bool bPopDecoded(Tile& tile);
+
+private:
+	void vRun();
+
+	TileSource& m_source;
+	int m_iTileSize;
+	int m_iBorder;
+	bool m_bRunning;
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	std::deque<uint32_t> m_requests;
+	std::deque<Tile> m_decoded;
+};
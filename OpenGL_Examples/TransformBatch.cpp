@@ -0,0 +1,155 @@
+#include <xmmintrin.h>
+#include "TransformBatch.h"
+
+/* Columns of four affine matrices, element [c][r] holds row r of column c for all four objects */
+struct Batch4
+{
+	__m128 aColumn[4][4];
+};
+
+static void vComposeBatch4(const glm::vec3* pPositions, const glm::quat* pRotations, const glm::vec3* pScales, const uint32_t* puiObjects, Batch4& batch)
+{
+	/* glm::quat keeps x, y, z, w in memory, a transpose gives one register per component */
+	__m128 x = _mm_loadu_ps(&pRotations[puiObjects[0]].x);
+	__m128 y = _mm_loadu_ps(&pRotations[puiObjects[1]].x);
+	__m128 z = _mm_loadu_ps(&pRotations[puiObjects[2]].x);
+	__m128 w = _mm_loadu_ps(&pRotations[puiObjects[3]].x);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+
+	const glm::vec3& s0 = pScales[puiObjects[0]];
+	const glm::vec3& s1 = pScales[puiObjects[1]];
+	const glm::vec3& s2 = pScales[puiObjects[2]];
+	const glm::vec3& s3 = pScales[puiObjects[3]];
+	__m128 scaleX = _mm_setr_ps(s0.x, s1.x, s2.x, s3.x);
+	__m128 scaleY = _mm_setr_ps(s0.y, s1.y, s2.y, s3.y);
+	__m128 scaleZ = _mm_setr_ps(s0.z, s1.z, s2.z, s3.z);
+
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 x2 = _mm_mul_ps(x, two);
+	__m128 y2 = _mm_mul_ps(y, two);
+	__m128 z2 = _mm_mul_ps(z, two);
+	__m128 xx = _mm_mul_ps(x, x2);
+	__m128 yy = _mm_mul_ps(y, y2);
+	__m128 zz = _mm_mul_ps(z, z2);
+	__m128 xy = _mm_mul_ps(x, y2);
+	__m128 xz = _mm_mul_ps(x, z2);
+	__m128 yz = _mm_mul_ps(y, z2);
+	__m128 wx = _mm_mul_ps(w, x2);
+	__m128 wy = _mm_mul_ps(w, y2);
+	__m128 wz = _mm_mul_ps(w, z2);
+
+	batch.aColumn[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), scaleX);
+	batch.aColumn[0][1] = _mm_mul_ps(_mm_add_ps(xy, wz), scaleX);
+	batch.aColumn[0][2] = _mm_mul_ps(_mm_sub_ps(xz, wy), scaleX);
+	batch.aColumn[0][3] = _mm_setzero_ps();
+	batch.aColumn[1][0] = _mm_mul_ps(_mm_sub_ps(xy, wz), scaleY);
+	batch.aColumn[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), scaleY);
+	batch.aColumn[1][2] = _mm_mul_ps(_mm_add_ps(yz, wx), scaleY);
+	batch.aColumn[1][3] = _mm_setzero_ps();
+	batch.aColumn[2][0] = _mm_mul_ps(_mm_add_ps(xz, wy), scaleZ);
+	batch.aColumn[2][1] = _mm_mul_ps(_mm_sub_ps(yz, wx), scaleZ);
+	batch.aColumn[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), scaleZ);
+	batch.aColumn[2][3] = _mm_setzero_ps();
+
+	const glm::vec3& p0 = pPositions[puiObjects[0]];
+	const glm::vec3& p1 = pPositions[puiObjects[1]];
+	const glm::vec3& p2 = pPositions[puiObjects[2]];
+	const glm::vec3& p3 = pPositions[puiObjects[3]];
+	batch.aColumn[3][0] = _mm_setr_ps(p0.x, p1.x, p2.x, p3.x);
+	batch.aColumn[3][1] = _mm_setr_ps(p0.y, p1.y, p2.y, p3.y);
+	batch.aColumn[3][2] = _mm_setr_ps(p0.z, p1.z, p2.z, p3.z);
+	batch.aColumn[3][3] = one;
+}
+
+/* Turn the per element registers back into four column major matrices */
+static void vStoreBatch4(Batch4& batch, float* apfOut[4])
+{
+	for (int c = 0; c < 4; c++)
+	{
+		__m128 r0 = batch.aColumn[c][0];
+		__m128 r1 = batch.aColumn[c][1];
+		__m128 r2 = batch.aColumn[c][2];
+		__m128 r3 = batch.aColumn[c][3];
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(apfOut[0] + c * 4, r0);
+		_mm_storeu_ps(apfOut[1] + c * 4, r1);
+		_mm_storeu_ps(apfOut[2] + c * 4, r2);
+		_mm_storeu_ps(apfOut[3] + c * 4, r3);
+	}
+}
+
+glm::mat4 TransformBatch::compose(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	glm::mat4 world = glm::mat4_cast(rotation);
+	world[0] = world[0] * scale.x;
+	world[1] = world[1] * scale.y;
+	world[2] = world[2] * scale.z;
+	world[3] = glm::vec4(position.x, position.y, position.z, 1.0f);
+	return world;
+}
+
+void TransformBatch::vCompose(const glm::vec3* pPositions, const glm::quat* pRotations, const glm::vec3* pScales, const uint32_t* puiObjects, size_t uiCount, glm::mat4* pWorld)
+{
+	size_t i = 0;
+	for (; i + 4 <= uiCount; i += 4)
+	{
+		Batch4 batch;
+		vComposeBatch4(pPositions, pRotations, pScales, puiObjects + i, batch);
+		float* apfOut[4];
+		for (int k = 0; k < 4; k++)
+		{
+			apfOut[k] = &pWorld[puiObjects[i + k]][0][0];
+		}
+		vStoreBatch4(batch, apfOut);
+	}
+	for (; i < uiCount; i++)
+	{
+		uint32_t uiObject = puiObjects[i];
+		pWorld[uiObject] = compose(pPositions[uiObject], pRotations[uiObject], pScales[uiObject]);
+	}
+}
+
+void TransformBatch::vComposeMVP(const glm::vec3* pPositions, const glm::quat* pRotations, const glm::vec3* pScales, const uint32_t* puiObjects, size_t uiCount, const glm::mat4& viewProjection, glm::mat4* pMVP)
+{
+	/* Every element of the view-projection matrix broadcast once for the whole batch */
+	__m128 aViewProjection[4][4];
+	for (int c = 0; c < 4; c++)
+	{
+		for (int r = 0; r < 4; r++)
+		{
+			aViewProjection[c][r] = _mm_set1_ps(viewProjection[c][r]);
+		}
+	}
+
+	size_t i = 0;
+	for (; i + 4 <= uiCount; i += 4)
+	{
+		Batch4 world;
+		vComposeBatch4(pPositions, pRotations, pScales, puiObjects + i, world);
+
+		/* Column c of the product is the view-projection applied to column c of the world matrix.
+		   Row 3 of the world matrix is (0, 0, 0, 1), so the first three columns need three terms */
+		Batch4 mvp;
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				__m128 sum = _mm_add_ps(_mm_mul_ps(aViewProjection[0][r], world.aColumn[c][0]),
+					_mm_add_ps(_mm_mul_ps(aViewProjection[1][r], world.aColumn[c][1]), _mm_mul_ps(aViewProjection[2][r], world.aColumn[c][2])));
+				mvp.aColumn[c][r] = (c == 3) ? _mm_add_ps(sum, aViewProjection[3][r]) : sum;
+			}
+		}
+		float* apfOut[4];
+		for (int k = 0; k < 4; k++)
+		{
+			apfOut[k] = &pMVP[i + k][0][0];
+		}
+		vStoreBatch4(mvp, apfOut);
+	}
+	for (; i < uiCount; i++)
+	{
+		uint32_t uiObject = puiObjects[i];
+		pMVP[i] = viewProjection * compose(pPositions[uiObject], pRotations[uiObject], pScales[uiObject]);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <../../glm/glm.hpp>
+#include <../../glm/gtc/quaternion.hpp>
+
+/* Composes translation, rotation and scale into 4x4 matrices for many
+   objects at once. Four objects share one SSE register per matrix element,
+   so the quaternion to matrix conversion and the scaling run once per four
+   objects, and the optional product with the view-projection matrix is
+   done in the same pass, before the matrices ever leave the registers.
+   The objects are picked through an index list, for example the dirty or
+   the visible ones */
+class TransformBatch
+{
+public:
+	/* pWorld[puiObjects[i]] = T * R * S of object puiObjects[i] */
+	static void vCompose(const glm::vec3* pPositions, const glm::quat* pRotations, const glm::vec3* pScales, const uint32_t* puiObjects, size_t uiCount, glm::mat4* pWorld);
+
+	/* pMVP[i] = viewProjection * T * R * S of object puiObjects[i], packed for an instance buffer */
+	static void vComposeMVP(const glm::vec3* pPositions, const glm::quat* pRotations, const glm::vec3* pScales, const uint32_t* puiObjects, size_t uiCount, const glm::mat4& viewProjection, glm::mat4* pMVP);
+
+	/* One object without SIMD, also used for the remainder of a batch */
+	static glm::mat4 compose(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+};
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <cmath>
+#include "VirtualTexture.h"
+
+static const UniformName uiUniformUVScale = ShaderProgram::uiIntern("vtUVScale");
+static const UniformName uiUniformPages = ShaderProgram::uiIntern("vtPages");
+static const UniformName uiUniformTileSize = ShaderProgram::uiIntern("vtTileSize");
+static const UniformName uiUniformMipCount = ShaderProgram::uiIntern("vtMipCount");
+static const UniformName uiUniformMipBias = ShaderProgram::uiIntern("vtMipBias");
+static const UniformName uiUniformPageTable = ShaderProgram::uiIntern("vtPageTable");
+static const UniformName uiUniformPhysical = ShaderProgram::uiIntern("vtPhysical");
+static const UniformName uiUniformBorder = ShaderProgram::uiIntern("vtBorder");
+static const UniformName uiUniformPhysicalSize = ShaderProgram::uiIntern("vtPhysicalSize");
+
+/* Page counts are rounded up to a power of two so every mip of the page
+   table halves exactly, the texels past the image are never addressed */
+int VirtualTexture::iPagesFor(int iSize, int iTileSize)
+{
+	int iPages = (iSize + iTileSize - 1) / iTileSize;
+	int iPow2 = 1;
+	while (iPow2 < iPages)
+	{
+		iPow2 <<= 1;
+	}
+	return iPow2;
+}
+
+VirtualTexture::VirtualTexture(TileSource& source, int iTileSize, int iBorder, int iSlotsX, int iSlotsY, int iFeedbackDivisor)
+	: m_source(source), m_iTileSize(iTileSize), m_iBorder(iBorder), m_iFeedbackDivisor(iFeedbackDivisor),
+	m_iPagesX(iPagesFor(source.iGetWidth(), iTileSize)), m_iPagesY(iPagesFor(source.iGetHeight(), iTileSize)),
+	m_uvScale((float)source.iGetWidth() / (m_iPagesX * iTileSize), (float)source.iGetHeight() / (m_iPagesY * iTileSize)),
+	m_cache(iSlotsX, iSlotsY, m_iPagesX, m_iPagesY), m_decoder(source, iTileSize, iBorder),
+	m_iScreenWidth(0), m_iScreenHeight(0), m_iFeedbackWidth(0), m_iFeedbackHeight(0),
+	m_uiFeedbackFBO(0), m_uiFeedbackColor(0), m_uiFeedbackDepth(0), m_iFeedbackWrite(0)
+{
+	m_auiFeedbackPBO[0] = m_auiFeedbackPBO[1] = 0;
+	m_afeedbackSync[0] = m_afeedbackSync[1] = 0;
+}
+
+bool VirtualTexture::bInit(int iScreenWidth, int iScreenHeight)
+{
+	int iSlotSize = m_iTileSize + 2 * m_iBorder;
+
+	/* The page table is sampled per mip with nearest filtering, its texels are slot coordinates */
+	m_pageTable.vCreate2D(m_iPagesX, m_iPagesY, m_cache.iGetMipCount(), GL_RGBA8);
+	m_pageTable.vSetSampling(GL_CLAMP_TO_EDGE, GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST);
+	m_physical.vCreate2D(m_cache.iGetSlotsX() * iSlotSize, m_cache.iGetSlotsY() * iSlotSize, 1, GL_RGBA8);
+	m_physical.vSetSampling(GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+
+	glGenFramebuffers(1, &m_uiFeedbackFBO);
+	glGenRenderbuffers(1, &m_uiFeedbackColor);
+	glGenRenderbuffers(1, &m_uiFeedbackDepth);
+	glGenBuffers(2, m_auiFeedbackPBO);
+	vResize(iScreenWidth, iScreenHeight);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_uiFeedbackFBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_uiFeedbackColor);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_uiFeedbackDepth);
+	bool bComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!bComplete)
+	{
+		std::cout << "ERROR::VIRTUAL_TEXTURE::The feedback framebuffer is not complete" << std::endl;
+		return false;
+	}
+
+	m_decoder.vStart();
+	std::cout << "Virtual texture: " << m_iPagesX << "x" << m_iPagesY << " pages, " << m_cache.iGetMipCount() << " mip levels" << std::endl;
+	return true;
+}
+
+void VirtualTexture::vRelease()
+{
+	m_decoder.vStop();
+	for (int i = 0; i < 2; i++)
+	{
+		if (m_afeedbackSync[i])
+		{
+			glDeleteSync(m_afeedbackSync[i]);
+			m_afeedbackSync[i] = 0;
+		}
+	}
+	glDeleteBuffers(2, m_auiFeedbackPBO);
+	glDeleteRenderbuffers(1, &m_uiFeedbackColor);
+	glDeleteRenderbuffers(1, &m_uiFeedbackDepth);
+	glDeleteFramebuffers(1, &m_uiFeedbackFBO);
+	m_pageTable.vRelease();
+	m_physical.vRelease();
+}
+
+void VirtualTexture::vResize(int iScreenWidth, int iScreenHeight)
+{
+	m_iScreenWidth = iScreenWidth;
+	m_iScreenHeight = iScreenHeight;
+	m_iFeedbackWidth = (iScreenWidth + m_iFeedbackDivisor - 1) / m_iFeedbackDivisor;
+	m_iFeedbackHeight = (iScreenHeight + m_iFeedbackDivisor - 1) / m_iFeedbackDivisor;
+
+	glBindRenderbuffer(GL_RENDERBUFFER, m_uiFeedbackColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_iFeedbackWidth, m_iFeedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_uiFeedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_iFeedbackWidth, m_iFeedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	/* Readbacks in flight refer to the old size, drop them */
+	for (int i = 0; i < 2; i++)
+	{
+		if (m_afeedbackSync[i])
+		{
+			glDeleteSync(m_afeedbackSync[i]);
+			m_afeedbackSync[i] = 0;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_auiFeedbackPBO[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)m_iFeedbackWidth * m_iFeedbackHeight * 4, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTexture::vSetCommonUniforms(const ShaderProgram& program) const
+{
+	program.vSetVec2(uiUniformUVScale, m_uvScale);
+	program.vSetVec2(uiUniformPages, glm::vec2((float)m_iPagesX, (float)m_iPagesY));
+	program.vSetFloat(uiUniformTileSize, (float)m_iTileSize);
+	program.vSetFloat(uiUniformMipCount, (float)m_cache.iGetMipCount());
+}
+
+void VirtualTexture::vSetFeedbackUniforms(const ShaderProgram& feedbackProgram) const
+{
+	vSetCommonUniforms(feedbackProgram);
+	feedbackProgram.vSetFloat(uiUniformMipBias, -std::log2((float)m_iFeedbackDivisor));
+}
+
+void VirtualTexture::vBeginFeedback(const ShaderProgram& feedbackProgram, GLStateCache& state)
+{
+	/* An unread readback in the slot we are about to write is simply superseded */
+	if (m_afeedbackSync[m_iFeedbackWrite])
+	{
+		glDeleteSync(m_afeedbackSync[m_iFeedbackWrite]);
+		m_afeedbackSync[m_iFeedbackWrite] = 0;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_uiFeedbackFBO);
+	state.vViewport(0, 0, m_iFeedbackWidth, m_iFeedbackHeight);
+	state.vClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	state.vUseProgram(feedbackProgram.uiGetName());
+}
+
+void VirtualTexture::vEndFeedback(GLStateCache& state)
+{
+	/* Read into the buffer asynchronously, the CPU looks at it a frame later */
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_auiFeedbackPBO[m_iFeedbackWrite]);
+	glReadPixels(0, 0, m_iFeedbackWidth, m_iFeedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_afeedbackSync[m_iFeedbackWrite] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_iFeedbackWrite ^= 1;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	state.vViewport(0, 0, m_iScreenWidth, m_iScreenHeight);
+}
+
+bool VirtualTexture::bReadFeedback()
+{
+	int iRead = m_iFeedbackWrite ^ 1;
+	if (m_afeedbackSync[iRead] == 0 || glClientWaitSync(m_afeedbackSync[iRead], 0, 0) == GL_TIMEOUT_EXPIRED)
+	{
+		return false;
+	}
+	glDeleteSync(m_afeedbackSync[iRead]);
+	m_afeedbackSync[iRead] = 0;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_auiFeedbackPBO[iRead]);
+	size_t uiPixels = (size_t)m_iFeedbackWidth * m_iFeedbackHeight;
+	const unsigned char* pucFeedback = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)uiPixels * 4, GL_MAP_READ_BIT);
+	if (pucFeedback == NULL)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		return false;
+	}
+
+	/* Layout written by vt_feedback.frag: x and y low bytes, mip + 1, high nibbles of x and y */
+	m_cache.vBeginFrame();
+	m_cache.vRequest(PageCache::uiPageKey(m_cache.iGetMipCount() - 1, 0, 0));
+	uint32_t uiLastKey = 0xFFFFFFFF;
+	for (size_t i = 0; i < uiPixels; i++)
+	{
+		const unsigned char* pucTexel = pucFeedback + i * 4;
+		if (pucTexel[2] == 0)
+		{
+			continue;
+		}
+		int iX = pucTexel[0] | ((pucTexel[3] & 0x0F) << 8);
+		int iY = pucTexel[1] | ((pucTexel[3] >> 4) << 8);
+		uint32_t uiKey = PageCache::uiPageKey(pucTexel[2] - 1, iX, iY);
+		if (uiKey != uiLastKey)
+		{
+			m_cache.vRequest(uiKey);
+			uiLastKey = uiKey;
+		}
+	}
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
+
+bool VirtualTexture::bUpdate(TextureStreamer& streamer, size_t uiMaxRequests)
+{
+	if (bReadFeedback())
+	{
+		m_cache.vCollectMissing(m_missing, uiMaxRequests);
+		for (size_t i = 0; i < m_missing.size(); i++)
+		{
+			m_decoder.vRequest(m_missing[i]);
+		}
+	}
+
+	/* Decoded tiles get a slot and go into the physical cache through the streamer */
+	int iSlotSize = m_iTileSize + 2 * m_iBorder;
+	TileDecoder::Tile tile;
+	while (m_decoder.bPopDecoded(tile))
+	{
+		int iSlot = tile.bValid ? m_cache.iAllocateSlot(tile.uiKey) : -1;
+		if (iSlot < 0)
+		{
+			m_cache.vCancel(tile.uiKey);
+			continue;
+		}
+		int iSlotX = iSlot % m_cache.iGetSlotsX();
+		int iSlotY = iSlot / m_cache.iGetSlotsX();
+		PendingTile pending;
+		pending.uiKey = tile.uiKey;
+		pending.uiTicket = streamer.uiQueue(m_physical.uiGetName(), GL_TEXTURE_2D, 0, 0, iSlotX * iSlotSize, iSlotY * iSlotSize, iSlotSize, iSlotSize, GL_RGBA, std::move(tile.pixels), false);
+		m_pendingTiles.push_back(pending);
+	}
+
+	/* A page only enters the page table once its texels are really in the slot */
+	for (size_t i = 0; i < m_pendingTiles.size();)
+	{
+		if (streamer.bIsComplete(m_pendingTiles[i].uiTicket))
+		{
+			m_cache.vMarkResident(m_pendingTiles[i].uiKey);
+			m_pendingTiles[i] = m_pendingTiles.back();
+			m_pendingTiles.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if (!m_cache.bUpdatePageTable())
+	{
+		return false;
+	}
+	for (int iMip = 0; iMip < m_cache.iGetMipCount(); iMip++)
+	{
+		m_pageTable.vSubImage(iMip, 0, m_cache.iGetPagesX(iMip), m_cache.iGetPagesY(iMip), GL_RGBA, m_cache.getPageTable(iMip).data());
+	}
+	return true;
+}
+
+void VirtualTexture::vBind(const ShaderProgram& program, int iPageTableUnit, int iPhysicalUnit, GLStateCache& state) const
+{
+	vSetCommonUniforms(program);
+	program.vSetInt(uiUniformPageTable, iPageTableUnit);
+	program.vSetInt(uiUniformPhysical, iPhysicalUnit);
+	program.vSetFloat(uiUniformBorder, (float)m_iBorder);
+	program.vSetVec2(uiUniformPhysicalSize, glm::vec2((float)m_physical.iGetWidth(), (float)m_physical.iGetHeight()));
+	state.vBindTexture(GL_TEXTURE0 + iPageTableUnit, m_pageTable.eGetTarget(), m_pageTable.uiGetName());
+	state.vBindTexture(GL_TEXTURE0 + iPhysicalUnit, m_physical.eGetTarget(), m_physical.uiGetName());
+}
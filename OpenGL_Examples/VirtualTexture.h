@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <../../glad/include/glad/glad.h>
+#include <../../glm/glm.hpp>
+#include "GLState.h"
+#include "PageCache.h"
+#include "ShaderProgram.h"
+#include "Texture.h"
+#include "TextureStreamer.h"
+#include "TileDecoder.h"
+
+/* Virtual texture for images far larger than what should stay in video
+   memory. Only the tiles the camera actually sees are resident: a low
+   resolution feedback pass writes the page each pixel needs, the page
+   cache turns that into tile requests and evictions, the tile decoder
+   produces the texels in the background and the streamer uploads them
+   into the physical cache texture. The page table texture tells the
+   shader in which slot each page lives (see vt_sample.frag) */
+class VirtualTexture
+{
+public:
+	VirtualTexture(TileSource& source, int iTileSize = 128, int iBorder = 4, int iSlotsX = 16, int iSlotsY = 16, int iFeedbackDivisor = 4);
+
+	bool bInit(int iScreenWidth, int iScreenHeight);
+	void vRelease();
+	void vResize(int iScreenWidth, int iScreenHeight);
+
+	/* Set the uniforms of a feedback program, a scene vertex shader linked with vt_feedback.frag */
+	void vSetFeedbackUniforms(const ShaderProgram& feedbackProgram) const;
+
+	/* The scene draws issued between these two go to the feedback pass, with the feedback program bound.
+	   Viewport, clear color and program go through the state cache so it stays in step */
+	void vBeginFeedback(const ShaderProgram& feedbackProgram, GLStateCache& state);
+	void vEndFeedback(GLStateCache& state);
+
+	/* Turn the last finished feedback into tile requests and upload the decoded tiles.
+	   Returns whether the page table was bound to update it */
+	bool bUpdate(TextureStreamer& streamer, size_t uiMaxRequests = 16);
+
+	/* Bind the page table and the physical cache and set the sampling uniforms of a program */
+	void vBind(const ShaderProgram& program, int iPageTableUnit, int iPhysicalUnit, GLStateCache& state) const;
+
+	const PageCache& getCache() const { return m_cache; }
+
+private:
+	struct PendingTile
+	{
+		uint32_t uiKey;
+		uint64_t uiTicket;
+	};
+
+	static int iPagesFor(int iSize, int iTileSize);
+	void vSetCommonUniforms(const ShaderProgram& program) const;
+	bool bReadFeedback();
+
+	TileSource& m_source;
+	int m_iTileSize;
+	int m_iBorder;
+	int m_iFeedbackDivisor;
+	int m_iPagesX;
+	int m_iPagesY;
+	glm::vec2 m_uvScale;
+	PageCache m_cache;
+	TileDecoder m_decoder;
+
+	Texture m_pageTable;
+	Texture m_physical;
+
+	int m_iScreenWidth;
+	int m_iScreenHeight;
+	int m_iFeedbackWidth;
+	int m_iFeedbackHeight;
+	GLuint m_uiFeedbackFBO;
+	GLuint m_uiFeedbackColor;
+	GLuint m_uiFeedbackDepth;
+	GLuint m_auiFeedbackPBO[2];
+	GLsync m_afeedbackSync[2];
+	int m_iFeedbackWrite;
+
+	std::vector<PendingTile> m_pendingTiles;
+	std::vector<uint32_t> m_missing;
+};
@@ -1,27 +1,241 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <random>
 #include <../../glad/include/glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "stb_image.h"
+#include "Bvh.h"
+#include "Camera.h"
+#include "CommandBuffer.h"
+#include "FixedTimestep.h"
+#include "FrameExchange.h"
+#include "FrameUniforms.h"
+#include "FrustumCuller.h"
+#include "GLState.h"
+#include "IndirectDraw.h"
+#include "InputSystem.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "AllocationCounter.h"
+#include "MeshBuilder.h"
+#include "RenderQueue.h"
+#include "SceneStore.h"
+#include "SelfTest.h"
+#include "ShaderProgram.h"
+#include "TextureAtlas.h"
+#include "TextureManager.h"
+#include "TextureStreamer.h"
+#include "TransformBatch.h"
+#include "VirtualTexture.h"
 
 #include <../../glm/glm.hpp>
 #include <../../glm/gtc/matrix_transform.hpp>
 #include <../../glm/gtc/type_ptr.hpp>
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+struct CubeField;
+struct RecordPartition;
+struct SimulationState;
+struct VirtualTextureState;
+
+void framebuffer_size_callback(GLFWwindow*, int width, int height);
+void vBindInput(InputSystem& input);
 void processInput(GLFWwindow *window);
-void openGLRendering(const GLuint shaderProgram, const GLuint VBO, const GLuint EBO, const GLuint VAO, const GLuint texture1, const GLuint texture2);
-void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, GLuint& texture1, GLuint& texture2, const GLuint uiShaderProgram);
+void vRenderThread(GLFWwindow* window);
+void vPickObject(const CubeField& field, double dCursorX, double dCursorY, int iWindowWidth, int iWindowHeight);
+void vSimulate(SimulationState& state, float fStep);
+void vAnimateField(const SimulationState& previous, const SimulationState& current, float fAlpha, CubeField& field);
+void vBenchmarkJobs(JobSystem& jobs);
+void vBenchmarkMeshes();
+void vBenchmarkCulling();
+void vBenchmarkTransforms();
+glm::quat objectRotation(unsigned int uiObject, float fSpinDegrees);
+void openGLRendering(const ShaderProgram& shaderProgram, const ShaderProgram& mvpProgram, bool bPrecomputedMVP, const GLuint VAO, TextureManager& textureManager, const int iAtlasTexture, FrameUniformBuffer& frameUniforms, IndirectDrawBuffer& indirectDraw, std::vector<RecordPartition>& partitions, GLStateCache& stateCache, InstanceBuffer& instanceBuffer, JobSystem& jobs, JobCounter& fieldUpdated, VirtualTextureState& virtualTexture, CubeField& field);
+void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, const InstanceBuffer& instanceBuffer, CubeField& field, int& iAtlasTexture, const ShaderProgram& shaderProgram, const ShaderProgram& mvpProgram, TextureManager& textureManager);
+void vBuildCubeField(CubeField& field, unsigned int uiCount);
+void vPrepareVirtualTexture(VirtualTextureState& virtualTexture, int iWidth, int iHeight);
 GLuint uiLoadShadersToProgram(const char* cVertexShaderPath, const char* cFragmentShaderPath, bool bMakeDefault);
 
+/* Uniforms are looked up by these interned names, never by string in the render loop */
+static const UniformName uiUniformAtlas = ShaderProgram::uiIntern("atlas");
+static const UniformName uiUniformUVRect1 = ShaderProgram::uiIntern("uvRect1");
+static const UniformName uiUniformUVRect2 = ShaderProgram::uiIntern("uvRect2");
+static const UniformName uiUniformLayer1 = ShaderProgram::uiIntern("layer1");
+static const UniformName uiUniformLayer2 = ShaderProgram::uiIntern("layer2");
+
+/* Meshes packed one after another into the shared vertex and index buffers */
+enum MeshId
+{
+	MESH_CUBE,
+	MESH_PYRAMID,
+	MESH_COUNT
+};
+
+/* Number of objects in the field, the hand placed ones are cubes and the walls behind them pyramids.
+   Whatever the count, the frame submits one indirect draw with a command per mesh */
+static const unsigned int uiCubeFieldSize = 10000;
+static const unsigned int uiHandPlacedCubes = 10;
+
+/* Everything the frame needs to know about the objects of the field */
+struct CubeField
+{
+	MeshRange meshes[MESH_COUNT];
+	SceneStore scene;
+	Bvh bvh;
+
+	/* Indices of the instances that passed culling, refilled every frame */
+	std::vector<uint32_t> visible;
+};
+
+/* The visible field is split into one slice per job system thread, each slice has its matrices written
+   and its draws recorded by a job. The render thread replays them all.
+   Recording state of one slice, reused every frame */
+struct RecordPartition
+{
+	RenderQueue renderQueue;
+	CommandBuffer commands;
+};
+
+/* Check every recorded command stream on the CPU before it is replayed */
+static const bool bValidateCommands = false;
+
+/* Culling splits the hierarchy into up to this many subtrees per job system thread */
+static const size_t uiCullSubtreesPerThread = 4;
+
+/* Measure the scheduling overhead of the job system once at start up */
+static const bool bBenchmarkJobs = false;
+
+/* Check the GL free policy classes before the window opens, see SelfTest.h */
+static const bool bRunSelfTests = false;
+
+/* Measure the vertex cache gain of MeshBuilder on a large grid before the window opens */
+static const bool bBenchmarkMeshes = false;
+
+/* Compare the SIMD frustum culler with the per sphere test on a million spheres before the window opens */
+static const bool bBenchmarkCulling = false;
+
+/* Compare TransformBatch with composing every matrix through glm before the window opens */
+static const bool bBenchmarkTransforms = false;
+
+/* Transient memory of one frame: job closures, cull lists and draw lists */
+static const size_t uiFrameArenaBytes = 1024 * 1024;
+
+/* Report every frame that allocated from the heap. The first frames are left out,
+   the containers kept across frames reach their final size there */
+static const bool bCheckAllocations = true;
+static const unsigned int uiAllocationWarmupFrames = 3;
+
+/* What the keys and the mouse are bound to, see vBindInput */
+enum InputAction
+{
+	ACTION_MOVE_FORWARD,
+	ACTION_MOVE_BACK,
+	ACTION_MOVE_LEFT,
+	ACTION_MOVE_RIGHT,
+	ACTION_QUIT,
+	ACTION_TOGGLE_MVP,
+	ACTION_PICK
+};
+
+/* Everything the simulation advances, a fixed step at a time. Rendering blends the last two states */
+struct SimulationState
+{
+	glm::vec3 cameraPosition;
+	/* Extra rotation of the hand placed cubes in degrees */
+	float fSpin;
+};
+
+/* What the main thread hands over to the render thread after every round of input and simulation */
+struct FramePacket
+{
+	SimulationState previous;
+	SimulationState current;
+	/* Time the current state belongs to, rendering blends from the previous one towards it */
+	double dCurrentTime;
+	float fStep;
+	int iFramebufferWidth;
+	int iFramebufferHeight;
+	/* Upload one combined model-view-projection matrix per instance instead of the model matrix,
+	   the vertex shader then does a single matrix product. M switches between both pipelines */
+	bool bPrecomputedMVP;
+	/* Counts the clicks, the render thread picks whenever it differs from the last one it handled */
+	uint32_t uiPickSerial;
+	/* The cursor is in window coordinates, which differ from framebuffer pixels on high DPI screens,
+	   so the window size of the click goes with it */
+	double dPickX;
+	double dPickY;
+	int iPickWindowWidth;
+	int iPickWindowHeight;
+};
+
+/* Speeds per simulated second, the camera speed matches the former 0.5 per frame at 60 frames per second */
+static const float fCameraSpeed = 30.0f;
+static const float fSpinSpeed = 20.0f;
+
+/* The simulation does not depend on the frame rate, so rendering is left uncapped */
+static const bool bVSync = false;
+
+/* Print the issued and elided GL state calls of every frame */
+static const bool bLogStateCalls = false;
+
+/* Serve the container image through a virtual texture instead of the atlas, see VirtualTexture.h */
+static const bool bVirtualTexture = false;
+static const int iVirtualPageTableUnit = 1;
+static const int iVirtualPhysicalUnit = 2;
+
+/* The virtual texture with its tile source and one feedback program per vertex shader,
+   only set up with bVirtualTexture */
+struct VirtualTextureState
+{
+	std::unique_ptr<ImageTileSource> pSource;
+	std::unique_ptr<VirtualTexture> pTexture;
+	ShaderProgram feedbackProgram;
+	ShaderProgram mvpFeedbackProgram;
+	int iWidth;
+	int iHeight;
+};
+
+/* The camera does not turn, only its position is simulated */
+static const glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+static const glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+
+/* Owned by the render thread, the viewport comes with the frame packets */
+Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), cameraFront, cameraUp);
+
+/* Filled by the GLFW callbacks, drained by processInput, both on the main thread */
+InputSystem input;
+
+/* The main thread owns the window and the events, the render thread the GL context and everything
+   on the GPU. They only share these packets */
+FrameExchange<FramePacket> framePackets;
+
+/* Direction the keys ask the camera to move in, processInput sets it and the simulation steps apply it */
+glm::vec3 cameraMove = glm::vec3(0.0f, 0.0f, 0.0f);
+
 int main()
 {
-	GLuint uiVAO;
-	GLuint uiEBO;
-	GLuint uiVBO;
-	GLuint uiTexture1, uiTexture2;
-	GLuint uiShaderProgram;
+	if (bRunSelfTests)
+	{
+		SelfTest::bRunAll();
+	}
+	if (bBenchmarkMeshes)
+	{
+		vBenchmarkMeshes();
+	}
+	if (bBenchmarkCulling)
+	{
+		vBenchmarkCulling();
+	}
+	if (bBenchmarkTransforms)
+	{
+		vBenchmarkTransforms();
+	}
 
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -39,68 +253,715 @@ int main()
 	{
 		std::cout << "The window has been shown correctly" << std::endl;
 	}
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	input.vAttach(window);
+	vBindInput(input);
+
+	/* The render thread starts from this packet. The framebuffer is larger than the window on high DPI
+	   screens, the callback fires only on changes */
+	FixedTimestep timestep;
+	SimulationState previousState = { camera.getPosition(), 0.0f };
+	SimulationState currentState = previousState;
+	double dLastTime = glfwGetTime();
+	FramePacket& firstPacket = framePackets.getWrite();
+	firstPacket.previous = previousState;
+	firstPacket.current = currentState;
+	firstPacket.dCurrentTime = dLastTime;
+	firstPacket.fStep = timestep.fGetStep();
+	glfwGetFramebufferSize(window, &firstPacket.iFramebufferWidth, &firstPacket.iFramebufferHeight);
+	firstPacket.bPrecomputedMVP = false;
+	firstPacket.uiPickSerial = 0;
+	firstPacket.dPickX = 0.0;
+	firstPacket.dPickY = 0.0;
+	firstPacket.iPickWindowWidth = 0;
+	firstPacket.iPickWindowHeight = 0;
+	framePackets.vPublish();
+
+	/* The GL context is made current on the render thread and stays there */
+	std::thread renderThread(vRenderThread, window);
+
+	/* This is the main loop, it waits for events or the next simulation step but never for the GPU */
+	while (!glfwWindowShouldClose(window) && !framePackets.bIsClosed())
+	{
+		glfwWaitEventsTimeout(timestep.fGetStep());
+
+		/* Processing of the input */
+		processInput(window);
+
+		/* Advance the simulation by the whole steps that fit into the elapsed time */
+		double dTime = glfwGetTime();
+		int iSteps = timestep.iAdvance(dTime - dLastTime);
+		dLastTime = dTime;
+		for (int i = 0; i < iSteps; i++)
+		{
+			previousState = currentState;
+			vSimulate(currentState, timestep.fGetStep());
+		}
+
+		FramePacket& packet = framePackets.getWrite();
+		packet.previous = previousState;
+		packet.current = currentState;
+		packet.dCurrentTime = dTime - timestep.fGetAlpha() * timestep.fGetStep();
+		framePackets.vPublish();
+	}
+	framePackets.vClose();
+	renderThread.join();
+	glfwTerminate();
+	return 0;
+}
+
+void vRenderThread(GLFWwindow* window)
+{
+	GLuint uiVAO;
+	GLuint uiEBO;
+	GLuint uiVBO;
+	CubeField field;
+	int iAtlasTexture;
+	ShaderProgram shaderProgram;
+	ShaderProgram mvpProgram;
+	TextureStreamer textureStreamer;
+	TextureManager textureManager(256 * 1024 * 1024);
+	IndirectDrawBuffer indirectDraw;
+	FrameUniformBuffer frameUniforms;
+	/* Created here, so the render thread is thread 0 of the job system and helps with every wait */
+	FrameArena frameArena(uiFrameArenaBytes);
+	JobSystem jobs(frameArena);
+	std::vector<RecordPartition> partitions(jobs.iGetThreadCount());
+	GLStateCache stateCache;
+	InstanceBuffer instanceBuffer(uiCubeFieldSize);
+	VirtualTextureState virtualTexture;
+
 	glfwMakeContextCurrent(window);
+	glfwSwapInterval(bVSync ? 1 : 0);
 
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 	{
 		std::cout << "Failed to initialize GLAD" << std::endl;
-		return -1;
+		framePackets.vClose();
+		return;
 	}
 	else
 	{
 		std::cout << "The GLAD has been initialized correctly" << std::endl;
 	}
-	glViewport(0, 0, 800, 600);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-	uiShaderProgram = uiLoadShadersToProgram("../OpenGL_Examples/shader.vert", "../OpenGL_Examples/shader.frag", false);
-	openGLPrepare(uiVBO, uiEBO, uiVAO, uiTexture1, uiTexture2, uiShaderProgram);
+	textureStreamer.bInit();
+	indirectDraw.bInit();
+	frameUniforms.bInit();
+	instanceBuffer.bInit();
+	const char* cFragmentShader = bVirtualTexture ? "../OpenGL_Examples/vt_sample.frag" : "../OpenGL_Examples/shader.frag";
+	shaderProgram.vCreate(uiLoadShadersToProgram("../OpenGL_Examples/shader.vert", cFragmentShader, false));
+	mvpProgram.vCreate(uiLoadShadersToProgram("../OpenGL_Examples/shader_mvp.vert", cFragmentShader, false));
+	stateCache.vSetFrameLog(bLogStateCalls);
+	openGLPrepare(uiVBO, uiEBO, uiVAO, instanceBuffer, field, iAtlasTexture, shaderProgram, mvpProgram, textureManager);
+
+	if (bBenchmarkJobs)
+	{
+		vBenchmarkJobs(jobs);
+	}
+
+	FramePacket packet;
+	framePackets.bAcquire(packet);
+	if (bVirtualTexture)
+	{
+		vPrepareVirtualTexture(virtualTexture, packet.iFramebufferWidth, packet.iFramebufferHeight);
+	}
+	uint32_t uiPickSerial = packet.uiPickSerial;
+	unsigned int uiFrame = 0;
 	/* This is the main rendering loop */
-	while (!glfwWindowShouldClose(window))
+	while (!framePackets.bIsClosed())
 	{
-		/* Processing of the input */
-		processInput(window);
+		size_t uiAllocations = AllocationCounter::uiGetCount();
+		/* Waits only if the GPU is still on the frame that last used this arena region */
+		frameArena.vBeginFrame();
+
+		/* Take the newest packet if there is one, otherwise keep blending towards the last state */
+		framePackets.bAcquire(packet);
+		camera.vSetViewport(packet.iFramebufferWidth, packet.iFramebufferHeight);
+		float fAlpha = (float)((glfwGetTime() - packet.dCurrentTime) / packet.fStep);
+		fAlpha = std::min(std::max(fAlpha, 0.0f), 1.0f);
+		camera.vSetPosition(glm::mix(packet.previous.cameraPosition, packet.current.cameraPosition, fAlpha));
+
+		/* Animation, transform update and refit run as a job while this thread does the texture work */
+		JobCounter fieldUpdated;
+		jobs.vParallelFor(1, 1, [&](size_t, size_t)
+		{
+			vAnimateField(packet.previous, packet.current, fAlpha, field);
+			/* Only objects that moved get a new world matrix, and the hierarchy is refit only if any did */
+			if (field.scene.uiUpdate() > 0)
+			{
+				field.bvh.vRefit(field.scene.getBounds());
+			}
+		}, fieldUpdated);
+
+		/* The virtual texture queues the tiles the last feedback asked for, then the uploads continue */
+		bool bTexturesBound = false;
+		if (virtualTexture.pTexture)
+		{
+			/* A minimized window has a 0x0 framebuffer, the feedback pass keeps its last size until it is restored */
+			bool bHasArea = packet.iFramebufferWidth > 0 && packet.iFramebufferHeight > 0;
+			if (bHasArea && (packet.iFramebufferWidth != virtualTexture.iWidth || packet.iFramebufferHeight != virtualTexture.iHeight))
+			{
+				virtualTexture.iWidth = packet.iFramebufferWidth;
+				virtualTexture.iHeight = packet.iFramebufferHeight;
+				virtualTexture.pTexture->vResize(virtualTexture.iWidth, virtualTexture.iHeight);
+			}
+			bTexturesBound |= virtualTexture.pTexture->bUpdate(textureStreamer);
+		}
+		/* Keep the textures within the memory budget and continue the pending uploads */
+		bTexturesBound |= textureManager.bUpdate(textureStreamer);
+		bTexturesBound |= textureStreamer.bUpdate();
+		/* Uploads, reloads and evictions bind textures behind the back of the cache, only then is what it
+		   knows about the texture units stale. Otherwise the binds of the last frame are still elided */
+		if (bTexturesBound)
+		{
+			stateCache.vInvalidateTextures();
+		}
+		if (virtualTexture.pTexture)
+		{
+			virtualTexture.pTexture->vBind(packet.bPrecomputedMVP ? mvpProgram : shaderProgram, iVirtualPageTableUnit, iVirtualPhysicalUnit, stateCache);
+		}
 
 		/* Rendering commands */
-		openGLRendering(uiShaderProgram, uiVBO, uiEBO, uiVAO, uiTexture1, uiTexture2);
+		openGLRendering(shaderProgram, mvpProgram, packet.bPrecomputedMVP, uiVAO, textureManager, iAtlasTexture, frameUniforms, indirectDraw, partitions, stateCache, instanceBuffer, jobs, fieldUpdated, virtualTexture, field);
+		stateCache.vEndFrame();
+		frameArena.vEndFrame();
+
+		/* Picking needs the camera of the frame just drawn */
+		if (packet.uiPickSerial != uiPickSerial)
+		{
+			uiPickSerial = packet.uiPickSerial;
+			vPickObject(field, packet.dPickX, packet.dPickY, packet.iPickWindowWidth, packet.iPickWindowHeight);
+		}
 
-		/* Get the event and swap buffer */
-		glfwPollEvents();
+		/* Swap buffer, a blocking swap only holds up this thread */
 		glfwSwapBuffers(window);
+
+		uiAllocations = AllocationCounter::uiGetCount() - uiAllocations;
+		if (bCheckAllocations && uiFrame >= uiAllocationWarmupFrames && uiAllocations > 0)
+		{
+			std::cout << "ERROR::FRAME::Frame " << uiFrame << " made " << uiAllocations << " heap allocations" << std::endl;
+		}
+		uiFrame++;
+	}
+	std::cout << "Frame arena: " << frameArena.uiGetPeakBytes() << " of " << frameArena.uiGetRegionBytes() << " bytes used at most" << std::endl;
+	/* How much the state cache saved over the whole run */
+	for (int i = 0; i < GLStateCache::CALL_COUNT; i++)
+	{
+		GLStateCache::StateCall eCall = (GLStateCache::StateCall)i;
+		std::cout << GLStateCache::cGetCallName(eCall) << ": " << stateCache.uiGetIssued(eCall) << " issued, " << stateCache.uiGetElided(eCall) << " elided" << std::endl;
 	}
 	glDeleteVertexArrays(1, &uiVAO);
 	glDeleteBuffers(1, &uiVBO);
 	glDeleteBuffers(1, &uiEBO);
-	glfwTerminate();
-	return 0;
+	shaderProgram.vRelease();
+	mvpProgram.vRelease();
+	indirectDraw.vRelease();
+	frameUniforms.vRelease();
+	instanceBuffer.vRelease();
+	textureManager.vRelease();
+	if (virtualTexture.pTexture)
+	{
+		virtualTexture.pTexture->vRelease();
+		virtualTexture.feedbackProgram.vRelease();
+		virtualTexture.mvpFeedbackProgram.vRelease();
+	}
+	textureStreamer.vRelease();
+	frameArena.vRelease();
+	glfwMakeContextCurrent(NULL);
 }
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+void framebuffer_size_callback(GLFWwindow*, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	framePackets.getWrite().iFramebufferWidth = width;
+	framePackets.getWrite().iFramebufferHeight = height;
 }
 
-glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
-glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
-glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+void vBindInput(InputSystem& input)
+{
+	input.vBindKey(GLFW_KEY_W, ACTION_MOVE_FORWARD);
+	input.vBindKey(GLFW_KEY_S, ACTION_MOVE_BACK);
+	input.vBindKey(GLFW_KEY_A, ACTION_MOVE_LEFT);
+	input.vBindKey(GLFW_KEY_D, ACTION_MOVE_RIGHT);
+	input.vBindKey(GLFW_KEY_ESCAPE, ACTION_QUIT);
+	input.vBindKey(GLFW_KEY_M, ACTION_TOGGLE_MVP);
+	input.vBindMouseButton(GLFW_MOUSE_BUTTON_LEFT, ACTION_PICK);
+}
 
 void processInput(GLFWwindow *window)
 {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	/* Everything that happened since the last frame, in the order it happened */
+	input.vProcessEvents();
+
+	if (input.bWasPressed(ACTION_QUIT))
 		glfwSetWindowShouldClose(window, true);
 
-	float cameraSpeed = 0.5f; // adjust accordingly
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		cameraPos += cameraSpeed * cameraFront;
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		cameraPos -= cameraSpeed * cameraFront;
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+	/* Only the direction is taken here, the distance comes from the simulation step */
+	cameraMove = glm::vec3(0.0f, 0.0f, 0.0f);
+	if (input.bIsDown(ACTION_MOVE_FORWARD))
+		cameraMove += cameraFront;
+	if (input.bIsDown(ACTION_MOVE_BACK))
+		cameraMove -= cameraFront;
+	if (input.bIsDown(ACTION_MOVE_LEFT))
+		cameraMove -= glm::normalize(glm::cross(cameraFront, cameraUp));
+	if (input.bIsDown(ACTION_MOVE_RIGHT))
+		cameraMove += glm::normalize(glm::cross(cameraFront, cameraUp));
+
+	/* The rest is for the render thread and goes out with the next packet */
+	FramePacket& packet = framePackets.getWrite();
+	if (input.bWasPressed(ACTION_TOGGLE_MVP))
+	{
+		packet.bPrecomputedMVP = !packet.bPrecomputedMVP;
+		std::cout << (packet.bPrecomputedMVP ? "Per instance MVP computed on the CPU" : "Per instance model matrix, MVP in the vertex shader") << std::endl;
+	}
+	if (input.bWasPressed(ACTION_PICK))
+	{
+		packet.uiPickSerial++;
+		packet.dPickX = input.dGetPressX(ACTION_PICK);
+		packet.dPickY = input.dGetPressY(ACTION_PICK);
+		glfwGetWindowSize(window, &packet.iPickWindowWidth, &packet.iPickWindowHeight);
+	}
+}
+
+void vSimulate(SimulationState& state, float fStep)
+{
+	state.cameraPosition += cameraMove * (fCameraSpeed * fStep);
+	state.fSpin = fmodf(state.fSpin + fSpinSpeed * fStep, 360.0f);
+}
+
+/* Hand the blended spin to the scene */
+void vAnimateField(const SimulationState& previous, const SimulationState& current, float fAlpha, CubeField& field)
+{
+	/* Blend the angle, not the quaternions, and take the short way across the wrap at 360 degrees */
+	float fDelta = current.fSpin - previous.fSpin;
+	if (fDelta < 0.0f)
+	{
+		fDelta += 360.0f;
+	}
+	float fSpin = previous.fSpin + fDelta * fAlpha;
+	for (unsigned int i = 0; i < uiHandPlacedCubes; i++)
+	{
+		field.scene.vSetRotation(i, objectRotation(i, fSpin));
+	}
+}
+
+glm::quat objectRotation(unsigned int uiObject, float fSpinDegrees)
+{
+	float angle = 20.0f * uiObject + fSpinDegrees;
+	return glm::angleAxis(glm::radians(angle), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
 }
 
-void openGLRendering(const GLuint shaderProgram, const GLuint VBO, const GLuint EBO, const GLuint VAO, const GLuint texture1, const GLuint texture2)
+/* Print the object under the cursor position of a click */
+void vPickObject(const CubeField& field, double dCursorX, double dCursorY, int iWindowWidth, int iWindowHeight)
+{
+	if (iWindowWidth <= 0 || iWindowHeight <= 0)
+	{
+		return;
+	}
+	/* Ray through the cursor, built from the camera basis and the same field of view as the projection */
+	float fX = 2.0f * (float)dCursorX / iWindowWidth - 1.0f;
+	float fY = 1.0f - 2.0f * (float)dCursorY / iWindowHeight;
+	float fTanHalfFov = camera.fGetTanHalfFov();
+	float fAspect = camera.fGetAspect();
+	glm::vec3 front = glm::normalize(camera.getFront());
+	glm::vec3 right = glm::normalize(glm::cross(front, camera.getUp()));
+	glm::vec3 up = glm::cross(right, front);
+	glm::vec3 direction = glm::normalize(front + right * (fX * fTanHalfFov * fAspect) + up * (fY * fTanHalfFov));
+
+	float fDistance;
+	int iObject = field.bvh.iRaycast(camera.getPosition(), direction, fDistance);
+	if (iObject >= 0)
+	{
+		std::cout << "Picked object " << iObject << " at distance " << fDistance << std::endl;
+	}
+	else
+	{
+		std::cout << "Nothing picked" << std::endl;
+	}
+}
+
+void openGLRendering(const ShaderProgram& shaderProgram, const ShaderProgram& mvpProgram, bool bPrecomputedMVP, const GLuint VAO, TextureManager& textureManager, const int iAtlasTexture, FrameUniformBuffer& frameUniforms, IndirectDrawBuffer& indirectDraw, std::vector<RecordPartition>& partitions, GLStateCache& stateCache, InstanceBuffer& instanceBuffer, JobSystem& jobs, JobCounter& fieldUpdated, VirtualTextureState& virtualTexture, CubeField& field)
+{
+	float timeValue = glfwGetTime();
+	const ShaderProgram& program = bPrecomputedMVP ? mvpProgram : shaderProgram;
+
+	/* Only what the input or a resize invalidated is rebuilt, the matrices go to the shared uniform block
+	   for every program at the same time */
+	bool bCameraChanged = camera.bUpdate();
+	FrameUniforms uniforms;
+	uniforms.view = camera.getView();
+	uniforms.projection = camera.getProjection();
+	uniforms.viewProjection = camera.getViewProjection();
+	uniforms.fTime = timeValue;
+	frameUniforms.vUpdate(uniforms, bCameraChanged);
+
+	/* Cull disjoint subtrees of the hierarchy in parallel. Each writes its survivors where its objects are
+	   in leaf order, so the outputs never overlap, and the gaps are closed afterwards */
+	jobs.vWait(fieldUpdated);
+	FrustumCuller culler;
+	culler.vSetViewProjection(uniforms.viewProjection);
+	size_t uiMaxSubtrees = uiCullSubtreesPerThread * jobs.iGetThreadCount();
+	uint32_t* puiRoots = jobs.getArena().pAllocateArray<uint32_t>(uiMaxSubtrees);
+	uint32_t* puiFirst = jobs.getArena().pAllocateArray<uint32_t>(uiMaxSubtrees);
+	size_t* puiCulled = jobs.getArena().pAllocateArray<size_t>(uiMaxSubtrees);
+	size_t uiVisible = 0;
+	if (puiRoots != NULL && puiFirst != NULL && puiCulled != NULL)
+	{
+		size_t uiSubtrees = field.bvh.uiGetSubtrees(puiRoots, uiMaxSubtrees);
+		JobCounter culled;
+		jobs.vParallelFor(uiSubtrees, 1, [&](size_t uiBegin, size_t uiEnd)
+		{
+			for (size_t i = uiBegin; i < uiEnd; i++)
+			{
+				uint32_t uiCount;
+				field.bvh.vGetObjectRange(puiRoots[i], puiFirst[i], uiCount);
+				puiCulled[i] = field.bvh.uiCullSubtree(culler, puiRoots[i], field.visible.data() + puiFirst[i]);
+			}
+		}, culled);
+		jobs.vWait(culled);
+		for (size_t i = 0; i < uiSubtrees; i++)
+		{
+			/* The survivors only ever move down. std::copy may not start writing inside its source, and a
+			   subtree with no gap before it, the first one always, is in place already */
+			if (uiVisible != puiFirst[i])
+			{
+				std::copy(field.visible.begin() + puiFirst[i], field.visible.begin() + puiFirst[i] + puiCulled[i], field.visible.begin() + uiVisible);
+			}
+			uiVisible += puiCulled[i];
+		}
+	}
+	else
+	{
+		uiVisible = field.bvh.uiCull(culler, field.visible.data());
+	}
+
+	/* Split the survivors by mesh, then write their matrices into this frame's instance region */
+	uint32_t* puiFirstPyramid = std::partition(field.visible.data(), field.visible.data() + uiVisible, [](uint32_t uiObject) { return uiObject < uiHandPlacedCubes; });
+	size_t uiVisibleCubes = (size_t)(puiFirstPyramid - field.visible.data());
+	glm::mat4* pInstances = instanceBuffer.pBegin();
+	GLuint uiBaseInstance = instanceBuffer.uiGetBaseInstance();
+
+	/* Clear the window and set the frame state, recorded ahead of the draws of the first slice */
+	for (size_t i = 0; i < partitions.size(); i++)
+	{
+		partitions[i].commands.vReset();
+	}
+	CommandBuffer& setup = partitions[0].commands;
+	setup.vViewport(0, 0, camera.iGetWidth(), camera.iGetHeight());
+	setup.vClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+	setup.vClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	/* Set the wireframe mode GL_LINE or GL_FILL*/
+	setup.vPolygonMode(GL_FILL);
+	setup.vSetEnabled(GL_DEPTH_TEST, true);
+
+	/* Every slice of the visible list writes its matrices to the same place in the instance region and
+	   records its draws in a job, no GL call is made. A slice may hold cubes, pyramids or both */
+	auto vRecordPartition = [&](size_t uiPartition)
+	{
+		size_t uiFirst = uiVisible * uiPartition / partitions.size();
+		size_t uiEnd = uiVisible * (uiPartition + 1) / partitions.size();
+		if (pInstances != NULL && bPrecomputedMVP)
+		{
+			/* Composed from position, rotation and scale and multiplied by the camera in one pass */
+			TransformBatch::vComposeMVP(field.scene.getPositions().data(), field.scene.getRotations().data(), field.scene.getScales().data(),
+				field.visible.data() + uiFirst, uiEnd - uiFirst, uniforms.viewProjection, pInstances + uiFirst);
+		}
+		else if (pInstances != NULL)
+		{
+			const std::vector<glm::mat4>& world = field.scene.getWorld();
+			for (size_t i = uiFirst; i < uiEnd; i++)
+			{
+				pInstances[i] = world[field.visible[i]];
+			}
+		}
+
+		RenderQueue& renderQueue = partitions[uiPartition].renderQueue;
+		size_t uiCubeEnd = std::min(std::max(uiVisibleCubes, uiFirst), uiEnd);
+		DrawItem item;
+		item.pProgram = &program;
+		item.iTexture = iAtlasTexture;
+		item.uiVertexArray = VAO;
+		renderQueue.vBegin(jobs.getArena(), MESH_COUNT);
+		if (uiCubeEnd > uiFirst)
+		{
+			item.mesh = field.meshes[MESH_CUBE];
+			item.uiInstanceCount = (GLuint)(uiCubeEnd - uiFirst);
+			item.uiBaseInstance = uiBaseInstance + (GLuint)uiFirst;
+			renderQueue.vPush(item, 0.0f);
+		}
+		if (uiEnd > uiCubeEnd)
+		{
+			item.mesh = field.meshes[MESH_PYRAMID];
+			item.uiInstanceCount = (GLuint)(uiEnd - uiCubeEnd);
+			item.uiBaseInstance = uiBaseInstance + (GLuint)uiCubeEnd;
+			renderQueue.vPush(item, 0.0f);
+		}
+		renderQueue.vRecord(partitions[uiPartition].commands);
+	};
+	JobCounter recorded;
+	jobs.vParallelFor(partitions.size(), 1, [&](size_t uiBegin, size_t uiEnd)
+	{
+		for (size_t i = uiBegin; i < uiEnd; i++)
+		{
+			vRecordPartition(i);
+		}
+	}, recorded);
+	jobs.vWait(recorded);
+
+	if (bValidateCommands)
+	{
+		for (size_t i = 0; i < partitions.size(); i++)
+		{
+			if (!partitions[i].commands.bValidate(uiBaseInstance, uiBaseInstance + (GLuint)instanceBuffer.iGetCapacity()))
+			{
+				std::cout << "ERROR::COMMANDS::Slice " << i << " recorded an invalid stream" << std::endl;
+			}
+		}
+	}
+
+	/* Draw it in slice order. The slices bind the same state, so their draws merge into one batch */
+	CommandReplayer replayer(stateCache, textureManager, indirectDraw, GL_UNSIGNED_SHORT);
+	replayer.vBegin();
+	for (size_t i = 0; i < partitions.size(); i++)
+	{
+		replayer.vReplay(partitions[i].commands);
+	}
+	replayer.vEnd();
+
+	/* The same instances again with the feedback program, they tell the virtual texture which pages they need */
+	if (virtualTexture.pTexture)
+	{
+		virtualTexture.pTexture->vBeginFeedback(bPrecomputedMVP ? virtualTexture.mvpFeedbackProgram : virtualTexture.feedbackProgram, stateCache);
+		stateCache.vBindVertexArray(VAO);
+		indirectDraw.vAdd(field.meshes[MESH_CUBE], (GLuint)uiVisibleCubes, uiBaseInstance);
+		indirectDraw.vAdd(field.meshes[MESH_PYRAMID], (GLuint)(uiVisible - uiVisibleCubes), uiBaseInstance + (GLuint)uiVisibleCubes);
+		indirectDraw.vSubmit(GL_TRIANGLES, GL_UNSIGNED_SHORT);
+		virtualTexture.pTexture->vEndFeedback(stateCache);
+	}
+	frameUniforms.vEndFrame();
+	instanceBuffer.vEndFrame();
+}
+
+/* Scheduling overhead per job: a flat burst of empty jobs, then jobs that spawn and wait for children */
+void vBenchmarkJobs(JobSystem& jobs)
+{
+	/* Every job takes its closure and descriptor from the frame arena, this many fit comfortably */
+	const size_t uiFlatJobs = 10000;
+	const size_t uiParents = 100;
+	const size_t uiChildren = 100;
+	for (int iRound = 0; iRound < 3; iRound++)
+	{
+		jobs.getArena().vBeginFrame();
+		std::atomic<size_t> uiRan(0);
+		auto start = std::chrono::high_resolution_clock::now();
+		JobCounter flat;
+		jobs.vParallelFor(uiFlatJobs, 1, [&uiRan](size_t, size_t) { uiRan.fetch_add(1, std::memory_order_relaxed); }, flat);
+		jobs.vWait(flat);
+		auto middle = std::chrono::high_resolution_clock::now();
+
+		JobSystem* pJobs = &jobs;
+		JobCounter parents;
+		jobs.vParallelFor(uiParents, 1, [&uiRan, pJobs](size_t, size_t)
+		{
+			JobCounter children;
+			pJobs->vParallelFor(uiChildren, 1, [&uiRan](size_t, size_t) { uiRan.fetch_add(1, std::memory_order_relaxed); }, children);
+			pJobs->vWait(children);
+		}, parents);
+		jobs.vWait(parents);
+		auto end = std::chrono::high_resolution_clock::now();
+		jobs.getArena().vEndFrame();
+
+		std::cout << "Jobs on " << jobs.iGetThreadCount() << " threads: "
+			<< std::chrono::duration<double, std::nano>(middle - start).count() / uiFlatJobs << " ns per flat job, "
+			<< std::chrono::duration<double, std::nano>(end - middle).count() / (uiParents * (uiChildren + 1)) << " ns per nested job, "
+			<< uiRan.load() << " of " << uiFlatJobs + uiParents * uiChildren << " ran" << std::endl;
+	}
+}
+
+/* ACMR of a 250x250 quad grid before and after vOptimize, once with the triangles in scanline order
+   and once shuffled, the way an exporter without any cache awareness might write them */
+void vBenchmarkMeshes()
+{
+	const int iQuads = 250;
+	std::vector<float> triangles;
+	triangles.reserve((size_t)iQuads * iQuads * 6 * 5);
+	for (int y = 0; y < iQuads; y++)
+	{
+		for (int x = 0; x < iQuads; x++)
+		{
+			const int aiCorners[6][2] = { { x, y }, { x + 1, y }, { x + 1, y + 1 }, { x, y }, { x + 1, y + 1 }, { x, y + 1 } };
+			for (int i = 0; i < 6; i++)
+			{
+				float fX = (float)aiCorners[i][0];
+				float fY = (float)aiCorners[i][1];
+				float afVertex[5] = { fX, fY, 0.0f, fX / iQuads, fY / iQuads };
+				triangles.insert(triangles.end(), afVertex, afVertex + 5);
+			}
+		}
+	}
+
+	const char* acOrders[] = { "scanline", "shuffled" };
+	for (int iOrder = 0; iOrder < 2; iOrder++)
+	{
+		if (iOrder == 1)
+		{
+			/* Swap whole triangles, 15 floats each */
+			std::mt19937 random(42);
+			size_t uiTriangles = triangles.size() / 15;
+			for (size_t i = uiTriangles - 1; i > 0; i--)
+			{
+				size_t j = std::uniform_int_distribution<size_t>(0, i)(random);
+				std::swap_ranges(triangles.begin() + i * 15, triangles.begin() + (i + 1) * 15, triangles.begin() + j * 15);
+			}
+		}
+
+		MeshBuilder builder(5);
+		if (!builder.bAddTriangles(triangles.data(), (int)(triangles.size() / 5)))
+		{
+			std::cout << "ERROR::MESH::The benchmark grid can not be built" << std::endl;
+			return;
+		}
+		const std::vector<uint16_t>& indices = builder.getIndices();
+		float fBefore = MeshBuilder::fACMR(indices.data(), indices.size(), 16);
+		auto start = std::chrono::high_resolution_clock::now();
+		builder.vOptimize();
+		auto end = std::chrono::high_resolution_clock::now();
+		std::cout << "Mesh benchmark, " << acOrders[iOrder] << ": " << indices.size() / 3 << " triangles, " << builder.iGetVertexCount() << " vertices, ACMR "
+			<< fBefore << " -> " << MeshBuilder::fACMR(indices.data(), indices.size(), 16) << " in "
+			<< std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+	}
+}
+
+/* A million spheres scattered around the camera, culled with uiCull (AVX or SSE, whichever the build
+   enables) and with bSphereVisible one by one. Both have to keep the same spheres */
+void vBenchmarkCulling()
+{
+	const size_t uiSpheres = 1000000;
+	BoundingSpheres spheres;
+	spheres.x.reserve(uiSpheres);
+	spheres.y.reserve(uiSpheres);
+	spheres.z.reserve(uiSpheres);
+	spheres.radius.reserve(uiSpheres);
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+	for (size_t i = 0; i < uiSpheres; i++)
+	{
+		glm::vec3 center(position(random), position(random), position(random));
+		spheres.vPush(center, radius(random));
+	}
+
+	FrustumCuller culler;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	culler.vSetViewProjection(projection * view);
+
+	std::vector<uint32_t> simd(uiSpheres);
+	std::vector<uint32_t> scalar(uiSpheres);
+	for (int iRound = 0; iRound < 3; iRound++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t uiSimdVisible = culler.uiCull(spheres, 0, uiSpheres, simd.data());
+		auto middle = std::chrono::high_resolution_clock::now();
+		size_t uiScalarVisible = 0;
+		for (size_t i = 0; i < uiSpheres; i++)
+		{
+			if (culler.bSphereVisible(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]))
+			{
+				scalar[uiScalarVisible++] = (uint32_t)i;
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		if (uiSimdVisible != uiScalarVisible || !std::equal(simd.begin(), simd.begin() + uiSimdVisible, scalar.begin()))
+		{
+			std::cout << "ERROR::CULLING::The SIMD and the scalar culler disagree, " << uiSimdVisible << " against " << uiScalarVisible << " visible" << std::endl;
+			return;
+		}
+		double dSimd = std::chrono::duration<double, std::nano>(middle - start).count();
+		double dScalar = std::chrono::duration<double, std::nano>(end - middle).count();
+#if defined(__AVX__)
+		const char* cPath = "AVX";
+#else
+		const char* cPath = "SSE";
+#endif
+		std::cout << "Culling " << uiSpheres << " spheres, " << uiSimdVisible << " visible: "
+			<< cPath << " " << dSimd / uiSpheres << " ns per sphere, scalar " << dScalar / uiSpheres << " ns per sphere, "
+			<< dScalar / dSimd << "x" << std::endl;
+	}
+}
+
+/* 100000 objects composed with glm::translate, mat4_cast and glm::scale one by one, then with
+   TransformBatch, with and without the view-projection product. The results have to match */
+void vBenchmarkTransforms()
+{
+	const size_t uiObjects = 100000;
+	std::vector<glm::vec3> positions(uiObjects);
+	std::vector<glm::quat> rotations(uiObjects);
+	std::vector<glm::vec3> scales(uiObjects);
+	std::vector<uint32_t> objects(uiObjects);
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+	for (size_t i = 0; i < uiObjects; i++)
+	{
+		positions[i] = glm::vec3(position(random), position(random), position(random));
+		rotations[i] = objectRotation((unsigned int)i, position(random));
+		scales[i] = glm::vec3(scale(random), scale(random), scale(random));
+		objects[i] = (uint32_t)i;
+	}
+	/* The frame composes a culled, scattered subset, not the objects in storage order */
+	std::shuffle(objects.begin(), objects.end(), random);
+	glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+		* glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::vector<glm::mat4> glmWorld(uiObjects);
+	std::vector<glm::mat4> glmMVP(uiObjects);
+	std::vector<glm::mat4> batchWorld(uiObjects);
+	std::vector<glm::mat4> batchMVP(uiObjects);
+	for (int iRound = 0; iRound < 3; iRound++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < uiObjects; i++)
+		{
+			uint32_t uiObject = objects[i];
+			glm::mat4 world = glm::translate(glm::mat4(1.0f), positions[uiObject]) * glm::mat4_cast(rotations[uiObject]) * glm::scale(glm::mat4(1.0f), scales[uiObject]);
+			glmWorld[uiObject] = world;
+			glmMVP[i] = viewProjection * world;
+		}
+		auto glmEnd = std::chrono::high_resolution_clock::now();
+		TransformBatch::vCompose(positions.data(), rotations.data(), scales.data(), objects.data(), uiObjects, batchWorld.data());
+		auto worldEnd = std::chrono::high_resolution_clock::now();
+		TransformBatch::vComposeMVP(positions.data(), rotations.data(), scales.data(), objects.data(), uiObjects, viewProjection, batchMVP.data());
+		auto mvpEnd = std::chrono::high_resolution_clock::now();
+
+		/* Same operations in a different order, so only rounding may differ */
+		float fWorldError = 0.0f;
+		float fMVPError = 0.0f;
+		for (size_t i = 0; i < uiObjects; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				for (int r = 0; r < 4; r++)
+				{
+					fWorldError = std::max(fWorldError, std::abs(glmWorld[i][c][r] - batchWorld[i][c][r]));
+					fMVPError = std::max(fMVPError, std::abs(glmMVP[i][c][r] - batchMVP[i][c][r]));
+				}
+			}
+		}
+		if (fWorldError > 1e-3f || fMVPError > 1e-3f)
+		{
+			std::cout << "ERROR::TRANSFORMS::TransformBatch and glm disagree by " << fWorldError << " in world and " << fMVPError << " in MVP" << std::endl;
+			return;
+		}
+		std::cout << "Transforms of " << uiObjects << " objects: glm "
+			<< std::chrono::duration<double, std::milli>(glmEnd - start).count() << " ms, vCompose "
+			<< std::chrono::duration<double, std::milli>(worldEnd - glmEnd).count() << " ms, vComposeMVP "
+			<< std::chrono::duration<double, std::milli>(mvpEnd - worldEnd).count() << " ms" << std::endl;
+	}
+}
+
+void vBuildCubeField(CubeField& field, unsigned int uiCount)
 {
 	glm::vec3 cubePositions[] = {
 		glm::vec3(0.0f,  0.0f,  0.0f),
@@ -114,60 +975,57 @@ void openGLRendering(const GLuint shaderProgram, const GLuint VBO, const GLuint
 		glm::vec3(1.5f,  0.2f, -1.5f),
 		glm::vec3(-1.3f,  1.0f, -1.5f)
 	};
+	/* The hand placed cubes come first, the rest fill 100x100 walls behind them */
+	field.visible.resize(uiCount);
+	for (unsigned int i = 0; i < uiCount; i++)
+	{
+		glm::vec3 position;
+		if (i < uiHandPlacedCubes)
+		{
+			position = cubePositions[i];
+		}
+		else
+		{
+			unsigned int j = i - uiHandPlacedCubes;
+			position = glm::vec3(2.0f * (float)(j % 100) - 100.0f, 2.0f * (float)((j / 100) % 100) - 100.0f, -30.0f - 4.0f * (float)(j / 10000));
+		}
+		/* Both meshes fit into the unit cube, whatever the rotation */
+		field.scene.uiAdd(position, objectRotation(i, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), 0.8661f);
+	}
+}
 
-	float timeValue = glfwGetTime();
-	float greenValue = (sin(timeValue) / 2.0f) + 0.5f;
-	int vertexColorLocation = 0; 
-
-	/* Start the shading program and set the uniform */
-	glUseProgram(shaderProgram);
-	vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
-	glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
-
-	// create transformations
-	glm::mat4 model;
-	model = glm::rotate(model, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
-	glm::mat4 view;
-	/* Point camera according the key button */
-	view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-
-	glm::mat4 projection;
-	GLfloat screenWidth = 800;
-	GLfloat screenHeight = 600;
-	projection = glm::perspective(glm::radians(45.0f), screenWidth / screenHeight, 0.1f, 100.0f);
-
-	glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-
-	/* Clear the window */
-	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	/* Bind the Buffers */
-	glActiveTexture(GL_TEXTURE0); 
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	glBindVertexArray(VAO);
-
-	/* Set the wireframe mode GL_LINE or GL_FILL*/
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+/* The container image becomes the tile source, the scene programs sample it through vt_sample.frag */
+void vPrepareVirtualTexture(VirtualTextureState& virtualTexture, int iWidth, int iHeight)
+{
+	int iImageWidth, iImageHeight, iChannels;
+	stbi_set_flip_vertically_on_load(false);
+	unsigned char* pucPixels = stbi_load("container.jpg", &iImageWidth, &iImageHeight, &iChannels, 0);
+	if (pucPixels == NULL)
+	{
+		std::cout << "ERROR::VIRTUAL_TEXTURE::Cannot load the texture" << std::endl;
+		return;
+	}
+	virtualTexture.pSource.reset(new ImageTileSource(pucPixels, iImageWidth, iImageHeight, iChannels));
+	stbi_image_free(pucPixels);
 
-	/* Draw the vertex array */
-	for (unsigned int i = 0; i < 10; i++)
+	virtualTexture.pTexture.reset(new VirtualTexture(*virtualTexture.pSource));
+	virtualTexture.iWidth = iWidth;
+	virtualTexture.iHeight = iHeight;
+	if (!virtualTexture.pTexture->bInit(iWidth, iHeight))
 	{
-		glm::mat4 model;
-		model = glm::translate(model, cubePositions[i]);
-		float angle = 20.0f * i;
-		model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-		glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		virtualTexture.pTexture->vRelease();
+		virtualTexture.pTexture.reset();
+		return;
 	}
+	virtualTexture.feedbackProgram.vCreate(uiLoadShadersToProgram("../OpenGL_Examples/shader.vert", "../OpenGL_Examples/vt_feedback.frag", false));
+	virtualTexture.mvpFeedbackProgram.vCreate(uiLoadShadersToProgram("../OpenGL_Examples/shader_mvp.vert", "../OpenGL_Examples/vt_feedback.frag", false));
+	virtualTexture.pTexture->vSetFeedbackUniforms(virtualTexture.feedbackProgram);
+	virtualTexture.pTexture->vSetFeedbackUniforms(virtualTexture.mvpFeedbackProgram);
 }
 
-void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, GLuint& texture1, GLuint& texture2, const GLuint uiShaderProgram)
+void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, const InstanceBuffer& instanceBuffer, CubeField& field, int& iAtlasTexture, const ShaderProgram& shaderProgram, const ShaderProgram& mvpProgram, TextureManager& textureManager)
 {
+	/* Cube */
 	float vertices[] = {
 		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
 		0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
@@ -209,8 +1067,63 @@ void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, GLuint& texture1, GLui
 		0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
 		0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
 		-0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f
+		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+
+		/* Pyramid */
+		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+		0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+		0.5f, -0.5f,  0.5f,  1.0f, 1.0f,
+		0.5f, -0.5f,  0.5f,  1.0f, 1.0f,
+		-0.5f, -0.5f,  0.5f,  0.0f, 1.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+
+		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+		0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+		0.0f,  0.5f,  0.0f,  0.5f, 1.0f,
+
+		0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+		0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+		0.0f,  0.5f,  0.0f,  0.5f, 1.0f,
+
+		0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+		-0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+		0.0f,  0.5f,  0.0f,  0.5f, 1.0f,
+
+		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+		-0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+		0.0f,  0.5f,  0.0f,  0.5f, 1.0f
 	};
+	const GLuint uiMeshVertices[MESH_COUNT] = { 36, 18 };
+
+	/* Weld the shared corners of every mesh and order its triangles for the vertex cache.
+	   Each mesh indexes its own vertices from zero, the base vertex moves it to its place in the buffer */
+	std::vector<float> meshVertices;
+	std::vector<uint16_t> indices;
+	const float* pfMeshSource = vertices;
+	for (int iMesh = 0; iMesh < MESH_COUNT; iMesh++)
+	{
+		MeshBuilder builder(5);
+		bool bBuilt = builder.bAddTriangles(pfMeshSource, (int)uiMeshVertices[iMesh]);
+		pfMeshSource += uiMeshVertices[iMesh] * 5;
+		if (!bBuilt)
+		{
+			/* An empty range, its indirect command draws nothing */
+			std::cout << "ERROR::MESH::Mesh " << iMesh << " can not be built, it is left out" << std::endl;
+			MeshRange empty = { 0, (GLuint)indices.size(), (GLint)(meshVertices.size() / 5) };
+			field.meshes[iMesh] = empty;
+			continue;
+		}
+		float fACMRBefore = MeshBuilder::fACMR(builder.getIndices().data(), builder.getIndices().size(), 16);
+		builder.vOptimize();
+		std::cout << "Mesh " << iMesh << ": " << uiMeshVertices[iMesh] << " -> " << builder.iGetVertexCount() << " vertices, ACMR "
+			<< fACMRBefore << " -> " << MeshBuilder::fACMR(builder.getIndices().data(), builder.getIndices().size(), 16) << std::endl;
+
+		field.meshes[iMesh].uiIndexCount = (GLuint)builder.getIndices().size();
+		field.meshes[iMesh].uiFirstIndex = (GLuint)indices.size();
+		field.meshes[iMesh].iBaseVertex = (GLint)(meshVertices.size() / 5);
+		meshVertices.insert(meshVertices.end(), builder.getVertices().begin(), builder.getVertices().end());
+		indices.insert(indices.end(), builder.getIndices().begin(), builder.getIndices().end());
+	}
 
 	float texCoords[] = {
 		0.0f, 0.0f,  // lower-left corner  
@@ -218,24 +1131,16 @@ void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, GLuint& texture1, GLui
 		0.5f, 1.0f   // top-center corner
 	};
 
-	/* Set the texture 1 for the vertexes */
-	glGenTextures(1, &texture1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	float borderColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	/* Pack all the textures into one array texture, so the frame binds it only once */
+	TextureAtlas atlas;
+	int iContainerImage = -1;
+	int iFaceImage = -1;
 
 	int width, height, nrChannels;
 	unsigned char *data = stbi_load("container.jpg", &width, &height, &nrChannels, 0);
 	if (data)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		iContainerImage = atlas.iAddImage(data, width, height, nrChannels);
 		stbi_image_free(data);
 	}
 	else
@@ -243,32 +1148,32 @@ void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, GLuint& texture1, GLui
 		std::cout << "Cannot load the texture" << std::endl;
 	}
 
-	/* Set the texture 1 for the vertexes */
-	glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	stbi_set_flip_vertically_on_load(true);
 	data = stbi_load("awesomeface.png", &width, &height, &nrChannels, 0);
 	if (data)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		iFaceImage = atlas.iAddImage(data, width, height, nrChannels);
 		stbi_image_free(data);
 	}
 	else
 	{
 		std::cout << "Cannot load the texture" << std::endl;
 	}
-	glUseProgram(uiShaderProgram);
-	glUniform1i(glGetUniformLocation(uiShaderProgram, "texture1"), 0); // set it manually
-	glUniform1i(glGetUniformLocation(uiShaderProgram, "texture2"), 1); // set it manually
-	glEnable(GL_DEPTH_TEST);
+	iAtlasTexture = atlas.iBuild(textureManager);
+
+	/* Every sampler reads the same atlas, only its layer and UV rectangle differ */
+	AtlasRegion missingRegion = { 0, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) };
+	const AtlasRegion& region1 = (iContainerImage >= 0) ? atlas.getRegion(iContainerImage) : missingRegion;
+	const AtlasRegion& region2 = (iFaceImage >= 0) ? atlas.getRegion(iFaceImage) : missingRegion;
+	const ShaderProgram* apPrograms[] = { &shaderProgram, &mvpProgram };
+	for (const ShaderProgram* pProgram : apPrograms)
+	{
+		pProgram->vSetInt(uiUniformAtlas, 0); // set it manually
+		pProgram->vSetVec4(uiUniformUVRect1, region1.uvRect);
+		pProgram->vSetVec4(uiUniformUVRect2, region2.uvRect);
+		pProgram->vSetFloat(uiUniformLayer1, (float)region1.iLayer);
+		pProgram->vSetFloat(uiUniformLayer2, (float)region2.iLayer);
+	}
 
 	/* Get the amount of Vertex Attributes supported by hardware */
 	int nrAttributes;
@@ -283,7 +1188,11 @@ void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, GLuint& texture1, GLui
 
 	/* Create Vertex Buffer */
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, meshVertices.size() * sizeof(float), meshVertices.data(), GL_STATIC_DRAW);
+
+	/* Create Element Buffer */
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
 
 	// position attribute
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -291,6 +1200,20 @@ void openGLPrepare(GLuint& VBO, GLuint& EBO, GLuint& VAO, GLuint& texture1, GLui
 	// texture coord attribute
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 	glEnableVertexAttribArray(1);
+
+	/* The field stays on the CPU, the frame copies the visible matrices into the instance buffer */
+	vBuildCubeField(field, uiCubeFieldSize);
+	field.scene.uiUpdate();
+	field.bvh.vBuild(field.scene.getBounds());
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.uiGetName());
+
+	// model or model-view-projection matrix attribute, one column per location and advanced once per instance
+	for (GLuint uiColumn = 0; uiColumn < 4; uiColumn++)
+	{
+		glVertexAttribPointer(2 + uiColumn, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(uiColumn * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(2 + uiColumn);
+		glVertexAttribDivisor(2 + uiColumn, 1);
+	}
 }
 
 GLuint uiLoadShadersToProgram(const char* cVertexShaderPath, const char* cFragmentShaderPath, bool bMakeDefault)
@@ -1,11 +1,13 @@
 #version 440 core
 out vec4 FragColor;
-in vec2 TexCoord;
+in vec2 TexCoord1;
+in vec2 TexCoord2;
 
-uniform sampler2D texture1;
-uniform sampler2D texture2;
+uniform sampler2DArray atlas;
+uniform float layer1;
+uniform float layer2;
 
 void main()
 {
-    FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.2);
+    FragColor = mix(texture(atlas, vec3(TexCoord1, layer1)), texture(atlas, vec3(TexCoord2, layer2)), 0.2);
 }
\ No newline at end of file
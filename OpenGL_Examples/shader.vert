@@ -1,15 +1,31 @@
 #version 440 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+/* Per instance model matrix, takes the locations 2 to 5 */
+layout (location = 2) in mat4 aModel;
 
-out vec2 TexCoord;
+out vec2 TexCoord1;
+out vec2 TexCoord2;
+/* The mesh UV before the atlas remap, for the virtual texture shaders */
+out vec2 MeshTexCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+/* Per frame camera data shared by all programs, see FrameUniforms.h */
+layout (std140, binding = 0) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    float time;
+};
+
+/* Atlas regions of both textures, xy = offset and zw = scale */
+uniform vec4 uvRect1;
+uniform vec4 uvRect2;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+    gl_Position = viewProjection * aModel * vec4(aPos, 1.0);
+    TexCoord1 = uvRect1.xy + aTexCoord * uvRect1.zw;
+    TexCoord2 = uvRect2.xy + aTexCoord * uvRect2.zw;
+    MeshTexCoord = aTexCoord;
 }
\ No newline at end of file
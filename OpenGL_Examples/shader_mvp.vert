@@ -0,0 +1,22 @@
+#version 440 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+/* Per instance model-view-projection matrix composed on the CPU, takes the locations 2 to 5 */
+layout (location = 2) in mat4 aMVP;
+
+out vec2 TexCoord1;
+out vec2 TexCoord2;
+/* The mesh UV before the atlas remap, for the virtual texture shaders */
+out vec2 MeshTexCoord;
+
+/* Atlas regions of both textures, xy = offset and zw = scale */
+uniform vec4 uvRect1;
+uniform vec4 uvRect2;
+
+void main()
+{
+    gl_Position = aMVP * vec4(aPos, 1.0);
+    TexCoord1 = uvRect1.xy + aTexCoord * uvRect1.zw;
+    TexCoord2 = uvRect2.xy + aTexCoord * uvRect2.zw;
+    MeshTexCoord = aTexCoord;
+}
\ No newline at end of file
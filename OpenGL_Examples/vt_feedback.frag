@@ -0,0 +1,23 @@
+#version 440 core
+out vec4 FragColor;
+in vec2 MeshTexCoord;
+
+/* Writes the virtual texture page every pixel needs: x and y low bytes,
+   mip + 1 (0 marks no request) and the high nibbles of x and y. The
+   pages are addressed by the mesh UV, the atlas remap does not apply */
+uniform vec2 vtUVScale;
+uniform vec2 vtPages;
+uniform float vtTileSize;
+uniform float vtMipCount;
+uniform float vtMipBias;
+
+void main()
+{
+    vec2 uv = clamp(MeshTexCoord * vtUVScale, 0.0, 0.999999);
+    vec2 texel = uv * vtPages * vtTileSize;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float mip = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + vtMipBias), 0.0, vtMipCount - 1.0);
+    vec2 page = floor(uv * max(vtPages / exp2(mip), vec2(1.0)));
+    FragColor = vec4(mod(page.x, 256.0), mod(page.y, 256.0), mip + 1.0, floor(page.x / 256.0) + floor(page.y / 256.0) * 16.0) / 255.0;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#version 440 core
+out vec4 FragColor;
+in vec2 TexCoord2;
+in vec2 MeshTexCoord;
+
+uniform sampler2DArray atlas;
+uniform float layer2;
+
+/* Drop-in for shader.frag with the first texture served virtually, it is
+   addressed by the mesh UV the same way vt_feedback.frag requests it.
+   Page table entries hold the slot and the mip of the
+   finest resident page, the physical cache holds the tiles with borders */
+uniform sampler2D vtPageTable;
+uniform sampler2D vtPhysical;
+uniform vec2 vtUVScale;
+uniform vec2 vtPages;
+uniform vec2 vtPhysicalSize;
+uniform float vtTileSize;
+uniform float vtBorder;
+uniform float vtMipCount;
+
+vec4 sampleVirtual(vec2 uv)
+{
+    uv = clamp(uv * vtUVScale, 0.0, 0.999999);
+    vec2 texel = uv * vtPages * vtTileSize;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float mip = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy)))), 0.0, vtMipCount - 1.0);
+
+    vec4 entry = textureLod(vtPageTable, uv, mip) * 255.0;
+    if (entry.a < 128.0)
+    {
+        /* Not even the root page has arrived yet */
+        return vec4(0.5, 0.5, 0.5, 1.0);
+    }
+    vec2 pages = max(vtPages / exp2(floor(entry.b + 0.5)), vec2(1.0));
+    vec2 inPage = fract(uv * pages);
+    float slotSize = vtTileSize + 2.0 * vtBorder;
+    vec2 physical = (floor(entry.rg + 0.5) * slotSize + vtBorder + inPage * vtTileSize) / vtPhysicalSize;
+    return textureLod(vtPhysical, physical, 0.0);
+}
+
+void main()
+{
+    FragColor = mix(sampleVirtual(MeshTexCoord), texture(atlas, vec3(TexCoord2, layer2)), 0.2);
+}
\ No newline at end of file